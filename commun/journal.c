@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include "tftp.h"
+#include "journal.h"
+
+// Enregistrement binaire du journal, formaté en texte par le thread d'écriture seulement
+struct evenement_journal {
+    long horodatage_us;      // Horloge murale
+    unsigned int session;
+    unsigned char niveau;
+    unsigned char evenement;
+    long bloc;
+    long valeur;
+    char texte[TAILLE_TEXTE_JOURNAL]; // Vide pour les événements par bloc
+};
+
+// Anneau du journal d'un thread : un seul producteur (le thread) et un seul consommateur (le thread d'écriture).
+// Un producteur qui trouve l'anneau plein abandonne l'enregistrement au lieu d'attendre
+struct anneau_journal {
+    unsigned long tete;              // Prochain enregistrement écrit, avancé par le producteur
+    unsigned long queue;             // Prochain enregistrement lu, avancé par le thread d'écriture
+    long perdus;                     // Enregistrements abandonnés, anneau plein
+    long supprimes;                  // Événements par bloc écartés par la limite de débit
+    long debut_limite;               // Début de la seconde de limitation en cours
+    int emis_limite;                 // Événements par bloc émis depuis debut_limite
+    long perdus_signales;            // Valeurs déjà rapportées par le thread d'écriture
+    long supprimes_signales;
+    struct anneau_journal *suivant;
+    struct evenement_journal evenements[TAILLE_ANNEAU_JOURNAL];
+};
+
+struct anneau_journal *anneaux_journal = NULL;
+pthread_mutex_t mutex_journal = PTHREAD_MUTEX_INITIALIZER;
+__thread struct anneau_journal *anneau_journal_local = NULL;
+int niveau_journal = NIVEAU_INFO;
+unsigned int prochaine_session_journal = 0;
+
+const char *noms_niveaux[] = {"erreur", "info", "debug"};
+const char *noms_evenements[] = {"requete", "fin", "erreur_client", "abandon", "erreur", "groupe", "doublon", "requete_invalide",
+                                 "fenetre", "ack", "retransmission", "expiration", "bloc_recu", "hors_sequence", "limite", "perte", "limites", "congestion"};
+
+// Fonction pour lire l'horloge murale en microsecondes
+long horloge_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// Fonction pour obtenir l'anneau de journal du thread courant, créé et inscrit à son premier événement
+struct anneau_journal *anneau_journal() {
+    if (anneau_journal_local == NULL) {
+        struct anneau_journal *a = calloc(1, sizeof(struct anneau_journal));
+        if (a == NULL) {
+            erreur("Erreur lors de l'allocation de l'anneau du journal");
+        }
+        pthread_mutex_lock(&mutex_journal);
+        a->suivant = anneaux_journal;
+        anneaux_journal = a;
+        pthread_mutex_unlock(&mutex_journal);
+        anneau_journal_local = a;
+    }
+    return anneau_journal_local;
+}
+
+// Fonction pour réserver l'enregistrement suivant de l'anneau, NULL si l'anneau est plein
+struct evenement_journal *reserver_evenement(struct anneau_journal *a) {
+    if (a->tete - __atomic_load_n(&a->queue, __ATOMIC_ACQUIRE) >= TAILLE_ANNEAU_JOURNAL) {
+        __atomic_store_n(&a->perdus, a->perdus + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    return &a->evenements[a->tete % TAILLE_ANNEAU_JOURNAL];
+}
+
+// Fonction pour publier l'enregistrement réservé au thread d'écriture
+void publier_evenement(struct anneau_journal *a) {
+    __atomic_store_n(&a->tete, a->tete + 1, __ATOMIC_RELEASE);
+}
+
+// Fonction pour journaliser un événement de session, avec un message formaté seulement si le niveau est actif
+void journaliser(int niveau, unsigned int session, int evenement, long bloc, const char *format, ...) {
+    if (niveau > niveau_journal) {
+        return;
+    }
+    struct anneau_journal *a = anneau_journal();
+    struct evenement_journal *e = reserver_evenement(a);
+    if (e == NULL) {
+        return;
+    }
+    e->horodatage_us = horloge_us();
+    e->session = session;
+    e->niveau = niveau;
+    e->evenement = evenement;
+    e->bloc = bloc;
+    e->valeur = 0;
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(e->texte, TAILLE_TEXTE_JOURNAL, format, arguments);
+    va_end(arguments);
+    publier_evenement(a);
+}
+
+// Fonction pour journaliser un événement par bloc (niveau debug), sans formatage et limité en débit par thread
+void journaliser_bloc(unsigned int session, int evenement, long bloc, long valeur) {
+    if (niveau_journal < NIVEAU_DEBUG) {
+        return;
+    }
+    struct anneau_journal *a = anneau_journal();
+    long maintenant = horloge_us();
+    if (maintenant - a->debut_limite >= 1000000) {
+        a->debut_limite = maintenant;
+        a->emis_limite = 0;
+    }
+    if (a->emis_limite >= LIMITE_JOURNAL_BLOCS) {
+        __atomic_store_n(&a->supprimes, a->supprimes + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    struct evenement_journal *e = reserver_evenement(a);
+    if (e == NULL) {
+        return;
+    }
+    a->emis_limite++;
+    e->horodatage_us = maintenant;
+    e->session = session;
+    e->niveau = NIVEAU_DEBUG;
+    e->evenement = evenement;
+    e->bloc = bloc;
+    e->valeur = valeur;
+    e->texte[0] = '\0';
+    publier_evenement(a);
+}
+
+// Fonction pour écrire un enregistrement sous forme de ligne clé=valeur, les erreurs sur la sortie d'erreur
+void ecrire_evenement(const struct evenement_journal *e) {
+    char date[32];
+    time_t secondes = e->horodatage_us / 1000000;
+    struct tm tm;
+    localtime_r(&secondes, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+    FILE *sortie = e->niveau == NIVEAU_ERREUR ? stderr : stdout;
+    fprintf(sortie, "%s.%06ld niveau=%s session=%u evenement=%s", date, e->horodatage_us % 1000000,
+            noms_niveaux[e->niveau], e->session, noms_evenements[e->evenement]);
+    if (e->texte[0] != '\0') {
+        fprintf(sortie, " bloc=%ld msg=\"%s\"\n", e->bloc, e->texte);
+    } else {
+        fprintf(sortie, " bloc=%ld valeur=%ld\n", e->bloc, e->valeur);
+    }
+}
+
+// Thread d'écriture du journal : vide tous les anneaux, puis attend quand il n'y a plus rien à écrire
+void *ecrire_journal(void *arg) {
+    (void)arg;
+    long dernier_bilan = 0;
+    while (1) {
+        int ecrits = 0;
+        long maintenant = horloge_us();
+        int bilan_du = maintenant - dernier_bilan >= PERIODE_BILAN_JOURNAL_US;
+        if (bilan_du) {
+            dernier_bilan = maintenant;
+        }
+        pthread_mutex_lock(&mutex_journal);
+        struct anneau_journal *anneaux = anneaux_journal;
+        pthread_mutex_unlock(&mutex_journal);
+        // Les anneaux sont ajoutés en tête et jamais retirés : la liste lue reste valable sans verrou
+        for (struct anneau_journal *a = anneaux; a != NULL; a = a->suivant) {
+            unsigned long tete = __atomic_load_n(&a->tete, __ATOMIC_ACQUIRE);
+            for (; a->queue != tete; ecrits++) {
+                ecrire_evenement(&a->evenements[a->queue % TAILLE_ANNEAU_JOURNAL]);
+                __atomic_store_n(&a->queue, a->queue + 1, __ATOMIC_RELEASE);
+            }
+            if (!bilan_du) {
+                continue;
+            }
+            struct evenement_journal bilan;
+            memset(&bilan, 0, sizeof(bilan));
+            bilan.horodatage_us = maintenant;
+            bilan.niveau = NIVEAU_INFO;
+            long supprimes = __atomic_load_n(&a->supprimes, __ATOMIC_RELAXED);
+            if (supprimes != a->supprimes_signales) {
+                bilan.evenement = EV_LIMITE;
+                bilan.valeur = supprimes - a->supprimes_signales;
+                ecrire_evenement(&bilan);
+                a->supprimes_signales = supprimes;
+            }
+            long perdus = __atomic_load_n(&a->perdus, __ATOMIC_RELAXED);
+            if (perdus != a->perdus_signales) {
+                bilan.niveau = NIVEAU_ERREUR;
+                bilan.evenement = EV_PERTE;
+                bilan.valeur = perdus - a->perdus_signales;
+                ecrire_evenement(&bilan);
+                a->perdus_signales = perdus;
+            }
+        }
+        fflush(stdout);
+        if (ecrits == 0) {
+            usleep(PERIODE_JOURNAL_US);
+        }
+    }
+    return NULL;
+}
+
+// Fonction pour démarrer le thread d'écriture du journal
+void demarrer_journal() {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ecrire_journal, NULL) != 0) {
+        erreur("Erreur lors de la création du thread du journal");
+    }
+    pthread_detach(thread);
+}
+
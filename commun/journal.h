@@ -0,0 +1,44 @@
+// Journal des serveurs : événements de session écrits dans un anneau par thread, formatés par un thread d'écriture
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#define TAILLE_ANNEAU_JOURNAL 512   // Enregistrements par anneau de journal (un anneau par thread), puissance de 2
+#define TAILLE_TEXTE_JOURNAL 256    // Message des événements de session
+#define LIMITE_JOURNAL_BLOCS 1000   // Événements par bloc journalisés par seconde et par thread au niveau debug
+#define PERIODE_JOURNAL_US 10000    // Attente du thread d'écriture quand tous les anneaux sont vides
+#define PERIODE_BILAN_JOURNAL_US 1000000 // Intervalle minimal entre deux bilans des événements écartés ou perdus
+
+#define NIVEAU_ERREUR 0
+#define NIVEAU_INFO 1
+#define NIVEAU_DEBUG 2
+
+
+// Événements du journal
+#define EV_REQUETE 0          // Requête acceptée, session ouverte
+#define EV_FIN 1              // Transfert terminé
+#define EV_ERREUR_CLIENT 2    // Paquet ERROR reçu du client
+#define EV_ABANDON 3          // Client muet, session abandonnée
+#define EV_ERREUR 4           // Erreur locale (fichier, socket)
+#define EV_GROUPE 5           // Groupe multicast
+#define EV_DOUBLON 6          // Requête retransmise ignorée
+#define EV_REQUETE_INVALIDE 7
+#define EV_FENETRE 8          // Fenêtre DATA envoyée : premier bloc et nombre de blocs
+#define EV_ACK 9              // ACK accepté : bloc acquitté et avance
+#define EV_RETRANSMISSION 10  // Reprise après un ACK partiel
+#define EV_EXPIRATION 11      // Expiration du délai de retransmission
+#define EV_BLOC_RECU 12       // Bloc DATA reçu dans l'ordre : numéro et taille
+#define EV_HORS_SEQUENCE 13   // Bloc DATA inattendu : numéro reçu et dernier bloc dans l'ordre
+#define EV_LIMITE 14          // Événements par bloc écartés par la limite de débit (écrit par le thread d'écriture)
+#define EV_PERTE 15           // Enregistrements perdus, anneau plein (écrit par le thread d'écriture)
+#define EV_LIMITES 16         // Limites de débit chargées ou rechargées
+#define EV_CONGESTION 17      // Fenêtre de congestion réduite après une perte : dernier bloc acquitté et nouvelle fenêtre
+
+extern int niveau_journal; // -L erreur|info|debug, -Q équivaut à -L erreur
+extern unsigned int prochaine_session_journal;
+extern const char *noms_niveaux[];
+
+void journaliser(int niveau, unsigned int session, int evenement, long bloc, const char *format, ...);
+void journaliser_bloc(unsigned int session, int evenement, long bloc, long valeur);
+void demarrer_journal();
+
+#endif
@@ -0,0 +1,289 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <arpa/inet.h>
+#include "tftp.h"
+#include "session.h"
+#include "journal.h"
+#include "limiteur.h"
+#include "metriques.h"
+
+struct limites limites = {0, 0, 0, 24};
+int limiteur_actif = 0;
+
+long tat_global = 0;
+struct seau_sous_reseau sous_reseaux[NB_SOUS_RESEAUX];
+struct seau_sous_reseau seau_debordement; // Partagé par les sous-réseaux sans place dans la table, limité comme les autres
+
+// Fonction pour lire un débit en bits par seconde, suivi de k, M ou G, et le convertir en octets par seconde.
+// Renvoie -1 si le débit est invalide
+long lire_debit(const char *texte, char **fin) {
+    double valeur = strtod(texte, fin);
+    if (*fin == texte || valeur < 0) {
+        return -1;
+    }
+    if (**fin == 'k' || **fin == 'K') {
+        valeur *= 1e3;
+        (*fin)++;
+    } else if (**fin == 'M') {
+        valeur *= 1e6;
+        (*fin)++;
+    } else if (**fin == 'G') {
+        valeur *= 1e9;
+        (*fin)++;
+    }
+    return (long)(valeur / 8);
+}
+
+// Fonction pour lire les limites, par exemple "global=10G sous_reseau=1G/24 session=100M".
+// Un niveau absent n'est pas limité. Renvoie -1 si le texte est invalide
+int lire_limites(const char *texte, struct limites *l) {
+    l->debit_global = 0;
+    l->debit_sous_reseau = 0;
+    l->debit_session = 0;
+    l->prefixe = 24;
+    char copie[TAILLE_LIMITES];
+    snprintf(copie, sizeof(copie), "%s", texte);
+    // Commentaires effacés jusqu'à la fin de leur ligne
+    for (char *commentaire = strchr(copie, '#'); commentaire != NULL; commentaire = strchr(commentaire, '#')) {
+        while (*commentaire != '\0' && *commentaire != '\n') {
+            *commentaire++ = ' ';
+        }
+    }
+    char *reste = NULL;
+    for (char *element = strtok_r(copie, " ,\t\r\n", &reste); element != NULL; element = strtok_r(NULL, " ,\t\r\n", &reste)) {
+        char *valeur = strchr(element, '=');
+        if (valeur == NULL) {
+            return -1;
+        }
+        *valeur++ = '\0';
+        char *fin;
+        long debit = lire_debit(valeur, &fin);
+        if (debit < 0) {
+            return -1;
+        }
+        if (strcmp(element, "global") == 0 && *fin == '\0') {
+            l->debit_global = debit;
+        } else if (strcmp(element, "session") == 0 && *fin == '\0') {
+            l->debit_session = debit;
+        } else if (strcmp(element, "sous_reseau") == 0) {
+            l->debit_sous_reseau = debit;
+            if (*fin == '/') {
+                char *fin_prefixe;
+                l->prefixe = strtol(fin + 1, &fin_prefixe, 10);
+                if (fin_prefixe == fin + 1 || *fin_prefixe != '\0' || l->prefixe < 0 || l->prefixe > 32) {
+                    return -1;
+                }
+            } else if (*fin != '\0') {
+                return -1;
+            }
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour charger les limites d'un fichier, au démarrage puis à chaque SIGHUP. Renvoie -1 si le fichier
+// est illisible ou invalide, les limites en vigueur restant alors inchangées
+int charger_limites(const char *chemin) {
+    FILE *fichier = fopen(chemin, "r");
+    if (fichier == NULL) {
+        return -1;
+    }
+    char texte[TAILLE_LIMITES];
+    size_t taille = fread(texte, 1, sizeof(texte) - 1, fichier);
+    texte[taille] = '\0';
+    fclose(fichier);
+    struct limites nouvelles;
+    if (lire_limites(texte, &nouvelles) < 0) {
+        return -1;
+    }
+    if (limiteur_actif && nouvelles.prefixe != limites.prefixe) {
+        // Les seaux des sous-réseaux déjà suivis sont indexés par l'ancien préfixe
+        journaliser(NIVEAU_ERREUR, 0, EV_LIMITES, 0, "Préfixe /%d ignoré, les sous-réseaux restent en /%d jusqu'au redémarrage",
+                    nouvelles.prefixe, limites.prefixe);
+    } else {
+        limites.prefixe = nouvelles.prefixe;
+    }
+    __atomic_store_n(&limites.debit_global, nouvelles.debit_global, __ATOMIC_RELAXED);
+    __atomic_store_n(&limites.debit_sous_reseau, nouvelles.debit_sous_reseau, __ATOMIC_RELAXED);
+    __atomic_store_n(&limites.debit_session, nouvelles.debit_session, __ATOMIC_RELAXED);
+    journaliser(NIVEAU_INFO, 0, EV_LIMITES, 0, "Limites de débit : global %ld, sous-réseau /%d %ld, session %ld bits/s",
+                nouvelles.debit_global * 8, limites.prefixe, nouvelles.debit_sous_reseau * 8, nouvelles.debit_session * 8);
+    return 0;
+}
+
+// Thread de rechargement : chaque SIGHUP relit le fichier des limites
+void *recharger_limites(void *arg) {
+    const char *chemin = arg;
+    sigset_t signaux;
+    sigemptyset(&signaux);
+    sigaddset(&signaux, SIGHUP);
+    while (1) {
+        int signal;
+        if (sigwait(&signaux, &signal) != 0) {
+            continue;
+        }
+        if (charger_limites(chemin) < 0) {
+            journaliser(NIVEAU_ERREUR, 0, EV_LIMITES, 0, "Fichier de limites '%s' illisible ou invalide, limites inchangées", chemin);
+        }
+    }
+    return NULL;
+}
+
+// Fonction pour charger les limites et démarrer le thread de rechargement. À appeler avant la création des
+// autres threads : ils héritent du masque qui réserve SIGHUP au thread de rechargement
+void demarrer_limiteur(const char *chemin) {
+    if (charger_limites(chemin) < 0) {
+        erreur("Fichier de limites illisible ou invalide");
+    }
+    limiteur_actif = 1;
+    sigset_t signaux;
+    sigemptyset(&signaux);
+    sigaddset(&signaux, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signaux, NULL);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, recharger_limites, (void *)chemin) != 0) {
+        erreur("Erreur lors de la création du thread des limites");
+    }
+    pthread_detach(thread);
+}
+
+// Fonction pour réserver l'envoi de octets dans un seau au plus tôt à l'instant donné (en nanosecondes),
+// renvoie l'instant de départ autorisé. L'instant théorique d'arrivée avance du temps d'émission des octets
+// au débit du seau ; un départ peut le précéder de RAFALE_NS au plus
+long reserver_jetons(long *tat, long debit, long octets, long au_plus_tot) {
+    if (debit <= 0) {
+        return au_plus_tot;
+    }
+    long cout = octets * 1000000000L / debit;
+    long ancien = __atomic_load_n(tat, __ATOMIC_RELAXED);
+    long depart, nouveau;
+    do {
+        depart = ancien - RAFALE_NS > au_plus_tot ? ancien - RAFALE_NS : au_plus_tot;
+        nouveau = (ancien > depart ? ancien : depart) + cout;
+    } while (!__atomic_compare_exchange_n(tat, &ancien, nouveau, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return depart;
+}
+
+// Fonction pour prendre une session sur un seau s'il porte la clé donnée, renvoie 1 en cas de succès
+int prendre_seau(struct seau_sous_reseau *s, unsigned long cle) {
+    unsigned long etat = __atomic_load_n(&s->etat, __ATOMIC_ACQUIRE);
+    while ((etat & CLE_SOUS_RESEAU) == cle) {
+        if (__atomic_compare_exchange_n(&s->etat, &etat, etat + UNE_SESSION, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour trouver le seau du sous-réseau d'un client et y compter la session. Le seau est réservé à la
+// première rencontre (sondage linéaire) ; si la table est pleine, le premier seau sans session et au repos depuis
+// plus de RAFALE_NS change de sous-réseau. Un tel seau laisse partir exactement ce qu'un seau neuf laisserait
+// partir, et les entrées n'étant jamais vidées les chaînes de sondage restent intactes. Faute de seau à reprendre,
+// le client partage le seau de débordement
+struct seau_sous_reseau *trouver_sous_reseau(const struct sockaddr_in *addr_client) {
+    unsigned int masque = limites.prefixe == 0 ? 0 : 0xFFFFFFFFu << (32 - limites.prefixe);
+    unsigned long cle = (ntohl(addr_client->sin_addr.s_addr) & masque) | (1UL << 32);
+    unsigned int indice = (unsigned int)((cle * 0x9E3779B97F4A7C15UL) >> 52) & (NB_SOUS_RESEAUX - 1);
+    for (int i = 0; i < NB_SOUS_RESEAUX; i++) {
+        struct seau_sous_reseau *s = &sous_reseaux[(indice + i) & (NB_SOUS_RESEAUX - 1)];
+        unsigned long libre = 0;
+        if (__atomic_compare_exchange_n(&s->etat, &libre, cle + UNE_SESSION, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return s;
+        }
+        // Entrée occupée, peut-être par le même sous-réseau
+        if (prendre_seau(s, cle)) {
+            return s;
+        }
+    }
+    long repos = maintenant_ns() - RAFALE_NS;
+    for (int i = 0; i < NB_SOUS_RESEAUX; i++) {
+        struct seau_sous_reseau *s = &sous_reseaux[(indice + i) & (NB_SOUS_RESEAUX - 1)];
+        unsigned long etat = __atomic_load_n(&s->etat, __ATOMIC_ACQUIRE);
+        // Sans session, aucun thread ne lit plus ce seau : son instant théorique d'arrivée est stable
+        if (etat >= UNE_SESSION || __atomic_load_n(&s->tat, __ATOMIC_RELAXED) > repos) {
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&s->etat, &etat, cle + UNE_SESSION, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return s;
+        }
+        // Seau repris entre-temps, peut-être pour le même sous-réseau par un thread parti du même indice
+        if (prendre_seau(s, cle)) {
+            return s;
+        }
+    }
+    compter(&compteurs()->sous_reseaux_debordes, 1);
+    return &seau_debordement;
+}
+
+// Fonction pour préparer la régulation d'une session
+void initialiser_regulation(struct regulation *r, const struct sockaddr_in *addr_client) {
+    r->tat = 0;
+    r->sous_reseau = limiteur_actif ? trouver_sous_reseau(addr_client) : NULL;
+    r->tat_rythme = 0;
+    r->debit_rythme = 0;
+    // Le réveil des attentes au débit visé demande la précision de l'horloge, sans le regroupement par défaut de 50 µs
+    prctl(PR_SET_TIMERSLACK, 1UL);
+}
+
+// Fonction pour rendre le seau du sous-réseau à la fin de la session, qui peut alors être repris une fois au repos
+void liberer_regulation(struct regulation *r) {
+    if (r->sous_reseau != NULL && r->sous_reseau != &seau_debordement) {
+        __atomic_sub_fetch(&r->sous_reseau->etat, UNE_SESSION, __ATOMIC_RELEASE);
+    }
+    r->sous_reseau = NULL;
+}
+
+// Fonction pour réserver l'envoi de octets au rythme de la session puis à travers les trois niveaux de limites,
+// renvoie l'instant de départ en nanosecondes. Chaque seau part de l'instant accordé par le précédent
+long reserver_envoi(struct regulation *r, long octets) {
+    long depart = reserver_jetons(&r->tat_rythme, r->debit_rythme, octets, maintenant_ns());
+    depart = reserver_jetons(&r->tat, __atomic_load_n(&limites.debit_session, __ATOMIC_RELAXED), octets, depart);
+    if (r->sous_reseau != NULL) {
+        depart = reserver_jetons(&r->sous_reseau->tat, __atomic_load_n(&limites.debit_sous_reseau, __ATOMIC_RELAXED), octets, depart);
+    }
+    return reserver_jetons(&tat_global, __atomic_load_n(&limites.debit_global, __ATOMIC_RELAXED), octets, depart);
+}
+
+// Fonction pour calculer le nombre de paquets envoyés d'un coup : ce que le plus bas des débits laisse partir
+// en RAFALE_NS, au moins un. Renvoie 0 si rien ne limite ni ne rythme la session
+int paquets_par_tranche(const struct regulation *r, int taille_paquet) {
+    long debit = 0;
+    long debits[4] = {r->debit_rythme,
+                      __atomic_load_n(&limites.debit_session, __ATOMIC_RELAXED),
+                      __atomic_load_n(&limites.debit_sous_reseau, __ATOMIC_RELAXED),
+                      __atomic_load_n(&limites.debit_global, __ATOMIC_RELAXED)};
+    for (int i = 0; i < 4; i++) {
+        if (debits[i] > 0 && (debit == 0 || debits[i] < debit)) {
+            debit = debits[i];
+        }
+    }
+    if (debit == 0) {
+        return 0;
+    }
+    long paquets = debit * (RAFALE_NS / 1000) / 1000000 / (taille_paquet + ENTETES_IP_UDP);
+    return paquets < 1 ? 1 : paquets > 65535 ? 65535 : (int)paquets;
+}
+
+// Fonction pour attendre l'instant de départ (horloge monotone, en nanosecondes) sur un timer haute résolution
+// à échéance absolue, sans dérive d'une attente à l'autre. Renvoie la durée attendue
+long attendre_depart(long echeance) {
+    long debut = maintenant_ns();
+    if (echeance <= debut) {
+        return 0;
+    }
+    struct timespec ts;
+    ts.tv_sec = echeance / 1000000000L;
+    ts.tv_nsec = echeance % 1000000000L;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+    return echeance - debut;
+}
@@ -0,0 +1,53 @@
+// Limitation hiérarchique du débit des paquets DATA : global, par sous-réseau et par session.
+// Chaque niveau est un seau à jetons tenu sous la forme d'un instant théorique d'arrivée (GCRA) : un seul
+// entier atomique par seau, avancé sans verrou par tous les threads qui envoient
+#ifndef LIMITEUR_H
+#define LIMITEUR_H
+
+#include <netinet/in.h>
+
+#define NB_SOUS_RESEAUX 4096   // Sous-réseaux suivis simultanément, puissance de 2
+#define RAFALE_NS 200000L      // Avance tolérée sur le débit : un seau au repos laisse partir 200 µs de trafic d'un coup
+#define ENTETES_IP_UDP 28      // Octets d'en-têtes IPv4 et UDP comptés en plus de chaque paquet TFTP
+#define TAILLE_LIMITES 1024    // Taille maximale du fichier des limites
+#define CLE_SOUS_RESEAU 0x1FFFFFFFFUL // Bits de l'état d'un seau portant la clé de son sous-réseau
+#define UNE_SESSION (1UL << 33)       // Unité du nombre de sessions rangé au-dessus de la clé
+
+// Débits en octets par seconde, 0 sans limite. Relus à chaque réservation : un rechargement s'applique
+// aussi aux sessions en cours
+struct limites {
+    long debit_global;
+    long debit_sous_reseau;
+    long debit_session;
+    int prefixe;               // Longueur du préfixe des sous-réseaux, fixée au démarrage
+};
+
+// Seau d'un sous-réseau, réservé au premier client qui en vient. Quand la table est pleine, un seau sans session
+// et au repos depuis plus de RAFALE_NS est repris par un nouveau sous-réseau
+struct seau_sous_reseau {
+    unsigned long etat;        // Adresse du réseau plus 1 << 32, et au-dessus le nombre de sessions ; 0 si l'entrée est libre
+    long tat;
+};
+
+// Régulation d'une session : son propre seau, celui de son sous-réseau et le rythme fixé par son contrôle de congestion
+struct regulation {
+    long tat;
+    struct seau_sous_reseau *sous_reseau; // NULL sans limites, seau de débordement commun si la table est pleine
+    long tat_rythme;
+    long debit_rythme;                    // Octets par seconde, 0 si l'envoi n'est pas rythmé
+};
+
+extern struct limites limites;
+extern int limiteur_actif; // 1 si le serveur a été démarré avec un fichier de limites
+
+int lire_limites(const char *texte, struct limites *l);
+int charger_limites(const char *chemin);
+void demarrer_limiteur(const char *chemin);
+long reserver_jetons(long *tat, long debit, long octets, long au_plus_tot);
+void initialiser_regulation(struct regulation *r, const struct sockaddr_in *addr_client);
+void liberer_regulation(struct regulation *r);
+long reserver_envoi(struct regulation *r, long octets);
+int paquets_par_tranche(const struct regulation *r, int taille_paquet);
+long attendre_depart(long echeance);
+
+#endif
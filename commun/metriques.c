@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "metriques.h"
+
+// Bornes supérieures des seaux de l'histogramme des RTT, en microsecondes
+const long bornes_rtt_us[NB_SEAUX_RTT] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+
+int metriques_cache = 0;
+int metriques_regulation = 0;
+
+// Compteurs de chaque thread, chaînés à leur création et jamais libérés
+struct compteurs_thread {
+    struct compteurs valeurs;
+    struct compteurs_thread *suivant;
+};
+
+struct compteurs_thread *liste_compteurs = NULL;
+pthread_mutex_t mutex_compteurs = PTHREAD_MUTEX_INITIALIZER;
+__thread struct compteurs *compteurs_locaux = NULL;
+
+// Fonction pour obtenir les compteurs du thread courant, créés et inscrits à sa première mesure
+struct compteurs *compteurs() {
+    if (compteurs_locaux == NULL) {
+        struct compteurs_thread *c = calloc(1, sizeof(struct compteurs_thread));
+        if (c == NULL) {
+            erreur("Erreur lors de l'allocation des compteurs");
+        }
+        pthread_mutex_lock(&mutex_compteurs);
+        c->suivant = liste_compteurs;
+        liste_compteurs = c;
+        pthread_mutex_unlock(&mutex_compteurs);
+        compteurs_locaux = &c->valeurs;
+    }
+    return compteurs_locaux;
+}
+
+// Fonction pour incrémenter un compteur du thread courant : seul écrivain, il se passe d'instruction atomique
+// de lecture-modification-écriture, l'écriture relâchée suffit pour une lecture cohérente par l'agrégation
+void compter(long *compteur, long n) {
+    __atomic_store_n(compteur, *compteur + n, __ATOMIC_RELAXED);
+}
+
+// Fonction pour compter les blocs DATA d'un envoi, dont ceux déjà envoyés une fois (retransmissions)
+void compter_envoi(long nb_blocs, long nb_retransmis, long octets) {
+    struct compteurs *c = compteurs();
+    compter(&c->blocs_envoyes, nb_blocs);
+    compter(&c->retransmissions, nb_retransmis);
+    compter(&c->octets_envoyes, octets);
+}
+
+// Fonction pour compter un paquet ERROR reçu d'un client
+void compter_erreur_recue(int code) {
+    compter(&compteurs()->erreurs_recues[code < NB_CODES_ERREUR ? code : 0], 1);
+}
+
+// Fonction pour additionner les compteurs de tous les threads
+void agreger_compteurs(struct compteurs *total) {
+    memset(total, 0, sizeof(*total));
+    long *somme = (long *)total;
+    pthread_mutex_lock(&mutex_compteurs);
+    for (struct compteurs_thread *c = liste_compteurs; c != NULL; c = c->suivant) {
+        long *valeurs = (long *)&c->valeurs;
+        for (size_t i = 0; i < sizeof(struct compteurs) / sizeof(long); i++) {
+            somme[i] += __atomic_load_n(&valeurs[i], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&mutex_compteurs);
+}
+
+// Fonction pour écrire une métrique simple au format texte de Prometheus
+int ecrire_metrique(char *tampon, size_t taille, const char *nom, const char *type, const char *aide, long valeur) {
+    return snprintf(tampon, taille, "# HELP %s %s\n# TYPE %s %s\n%s %ld\n", nom, aide, nom, type, nom, valeur);
+}
+
+// Fonction pour écrire une métrique par code d'erreur TFTP
+int ecrire_metrique_erreurs(char *tampon, size_t taille, const char *nom, const char *aide, const long *valeurs) {
+    int n = snprintf(tampon, taille, "# HELP %s %s\n# TYPE %s counter\n", nom, aide, nom);
+    for (int code = 0; code < NB_CODES_ERREUR; code++) {
+        n += snprintf(tampon + n, taille - n, "%s{code=\"%d\"} %ld\n", nom, code, valeurs[code]);
+    }
+    return n;
+}
+
+// Fonction pour produire toutes les métriques agrégées, renvoie la taille du texte
+int ecrire_metriques(char *tampon, size_t taille) {
+    struct compteurs t;
+    agreger_compteurs(&t);
+    int n = 0;
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_octets_envoyes_total", "counter", "Octets de données envoyés dans les paquets DATA", t.octets_envoyes);
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_octets_recus_total", "counter", "Octets de données reçus dans l'ordre par les WRQ", t.octets_recus);
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_blocs_envoyes_total", "counter", "Paquets DATA envoyés, retransmissions comprises", t.blocs_envoyes);
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_blocs_recus_total", "counter", "Paquets DATA reçus dans l'ordre", t.blocs_recus);
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_retransmissions_total", "counter", "Paquets DATA, OACK et ACK renvoyés", t.retransmissions);
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_expirations_total", "counter", "Expirations du délai de retransmission", t.expirations);
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_sessions_total", "counter", "Sessions ouvertes", t.sessions_ouvertes);
+    n += ecrire_metrique(tampon + n, taille - n, "tftp_sessions_actives", "gauge", "Sessions en cours", t.sessions_ouvertes - t.sessions_fermees);
+    if (metriques_cache) {
+        n += ecrire_metrique(tampon + n, taille - n, "tftp_cache_succes_total", "counter", "Fichiers servis depuis le cache", t.cache_succes);
+        n += ecrire_metrique(tampon + n, taille - n, "tftp_cache_echecs_total", "counter", "Fichiers absents du cache et chargés", t.cache_echecs);
+    }
+    if (metriques_regulation) {
+        n += snprintf(tampon + n, taille - n, "# HELP tftp_regulation_attente_secondes_total Temps passé à attendre la limite de débit\n"
+                      "# TYPE tftp_regulation_attente_secondes_total counter\ntftp_regulation_attente_secondes_total %g\n", t.attente_regulation_ns / 1e9);
+        n += snprintf(tampon + n, taille - n, "# HELP tftp_sous_reseaux_debordes_total Sessions limitées par le seau de débordement, la table des sous-réseaux étant pleine\n"
+                      "# TYPE tftp_sous_reseaux_debordes_total counter\ntftp_sous_reseaux_debordes_total %ld\n", t.sous_reseaux_debordes);
+    }
+    n += ecrire_metrique_erreurs(tampon + n, taille - n, "tftp_erreurs_envoyees_total", "Paquets ERROR envoyés, par code", t.erreurs_envoyees);
+    n += ecrire_metrique_erreurs(tampon + n, taille - n, "tftp_erreurs_recues_total", "Paquets ERROR reçus des clients, par code", t.erreurs_recues);
+    n += snprintf(tampon + n, taille - n, "# HELP tftp_rtt_secondes RTT mesurés selon la règle de Karn\n# TYPE tftp_rtt_secondes histogram\n");
+    long cumul = 0;
+    for (int i = 0; i <= NB_SEAUX_RTT; i++) {
+        cumul += t.seaux_rtt[i];
+        if (i < NB_SEAUX_RTT) {
+            n += snprintf(tampon + n, taille - n, "tftp_rtt_secondes_bucket{le=\"%g\"} %ld\n", bornes_rtt_us[i] / 1e6, cumul);
+        } else {
+            n += snprintf(tampon + n, taille - n, "tftp_rtt_secondes_bucket{le=\"+Inf\"} %ld\n", cumul);
+        }
+    }
+    n += snprintf(tampon + n, taille - n, "tftp_rtt_secondes_sum %g\ntftp_rtt_secondes_count %ld\n", t.somme_rtt_us / 1e6, t.nb_rtt);
+    return n;
+}
+
+// Thread des métriques : chaque connexion au socket Unix reçoit les compteurs agrégés au format de Prometheus
+void *servir_metriques(void *arg) {
+    const char *chemin = arg;
+    int ecoute = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ecoute < 0) {
+        erreur("Erreur lors de la création du socket des métriques");
+    }
+    struct sockaddr_un adresse;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sun_family = AF_UNIX;
+    snprintf(adresse.sun_path, sizeof(adresse.sun_path), "%s", chemin);
+    unlink(chemin);
+    if (bind(ecoute, (struct sockaddr *)&adresse, sizeof(adresse)) < 0 || listen(ecoute, 16) < 0) {
+        erreur("Erreur lors du liage du socket des métriques");
+    }
+    char *tampon = malloc(TAILLE_METRIQUES);
+    if (tampon == NULL) {
+        erreur("Erreur lors de l'allocation du tampon des métriques");
+    }
+    while (1) {
+        int client = accept(ecoute, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        int taille = ecrire_metriques(tampon, TAILLE_METRIQUES);
+        for (int ecrit = 0; ecrit < taille;) {
+            // Un client parti avant la fin (EPIPE, ECONNRESET) est abandonné sans que SIGPIPE arrête le serveur
+            ssize_t n = send(client, tampon + ecrit, taille - ecrit, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            ecrit += n;
+        }
+        close(client);
+    }
+    return NULL;
+}
+
+// Fonction pour démarrer le thread des métriques sur le socket Unix donné
+void demarrer_metriques(char *chemin) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, servir_metriques, chemin) != 0) {
+        erreur("Erreur lors de la création du thread des métriques");
+    }
+    pthread_detach(thread);
+}
+
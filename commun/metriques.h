@@ -0,0 +1,45 @@
+// Compteurs par thread des serveurs, agrégés et servis au format texte de Prometheus sur un socket Unix
+#ifndef METRIQUES_H
+#define METRIQUES_H
+
+#include <stddef.h>
+#include "tftp.h"
+
+#define NB_SEAUX_RTT 12       // Seaux de l'histogramme des RTT, plus le seau +Inf
+#define TAILLE_METRIQUES 16384
+
+// Compteurs d'un thread, écrits par lui seul sans verrou et additionnés à la demande par le thread des métriques.
+// Tous les champs sont des long : l'agrégation parcourt la structure comme un tableau
+struct compteurs {
+    long octets_envoyes;
+    long octets_recus;
+    long blocs_envoyes;
+    long blocs_recus;
+    long retransmissions;
+    long expirations;
+    long sessions_ouvertes;
+    long sessions_fermees;
+    long cache_succes;
+    long cache_echecs;
+    long erreurs_envoyees[NB_CODES_ERREUR];
+    long erreurs_recues[NB_CODES_ERREUR];
+    long seaux_rtt[NB_SEAUX_RTT + 1];
+    long somme_rtt_us;
+    long nb_rtt;
+    long attente_regulation_ns;
+    long sous_reseaux_debordes;
+};
+
+extern const long bornes_rtt_us[NB_SEAUX_RTT];
+extern int metriques_cache; // 1 si le serveur a un cache de fichiers dont les compteurs sont publiés
+extern int metriques_regulation; // 1 si le débit est limité
+
+struct compteurs *compteurs();
+void compter(long *compteur, long n);
+void compter_envoi(long nb_blocs, long nb_retransmis, long octets);
+void compter_erreur_recue(int code);
+void agreger_compteurs(struct compteurs *total);
+int ecrire_metriques(char *tampon, size_t taille);
+void demarrer_metriques(char *chemin);
+
+#endif
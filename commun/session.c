@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "session.h"
+#include "metriques.h"
+
+const char *noms_congestion[] = {"aucun", "aimd", "delai"};
+
+// Fonction pour lire l'horloge monotone en microsecondes
+long maintenant_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// Fonction pour lire l'horloge monotone en nanosecondes
+long maintenant_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Fonction pour initialiser l'estimateur, avec un délai fixe (en secondes) si l'option timeout a été négociée
+void initialiser_rtt(struct estimateur_rtt *e, int timeout) {
+    e->srtt = 0;
+    e->rttvar = 0;
+    e->attente = 0;
+    e->rto_applique = 0;
+    e->echeance = 0;
+    e->dernier_rtt = 0;
+    e->nb_mesures = 0;
+    if (timeout > 0) {
+        e->rto_min = e->rto_max = e->rto = timeout * 1000000L;
+    } else {
+        e->rto_min = RTO_MIN_US;
+        e->rto_max = TIMEOUT_SEC * 1000000L;
+        e->rto = RTO_INITIAL_US;
+    }
+}
+
+// Fonction pour intégrer une mesure de RTT, prise uniquement sur un paquet jamais retransmis (règle de Karn)
+void mesurer_rtt(struct estimateur_rtt *e, long mesure) {
+    if (e->srtt == 0) {
+        e->srtt = mesure > 0 ? mesure : 1;
+        e->rttvar = mesure / 2;
+    } else {
+        long ecart = e->srtt > mesure ? e->srtt - mesure : mesure - e->srtt;
+        e->rttvar = (3 * e->rttvar + ecart) / 4;
+        e->srtt = (7 * e->srtt + mesure) / 8;
+    }
+    long rto = e->srtt + (4 * e->rttvar > GRANULARITE_US ? 4 * e->rttvar : GRANULARITE_US);
+    e->rto = rto < e->rto_min ? e->rto_min : (rto > e->rto_max ? e->rto_max : rto);
+    e->dernier_rtt = mesure > 0 ? mesure : 1;
+    e->nb_mesures++;
+
+    // Histogramme des mesures pour les métriques
+    struct compteurs *c = compteurs();
+    int seau = 0;
+    while (seau < NB_SEAUX_RTT && mesure > bornes_rtt_us[seau]) {
+        seau++;
+    }
+    compter(&c->seaux_rtt[seau], 1);
+    compter(&c->somme_rtt_us, mesure);
+    compter(&c->nb_rtt, 1);
+}
+
+// Fonction pour noter une progression du transfert
+void progression_rtt(struct estimateur_rtt *e) {
+    e->attente = 0;
+}
+
+// Fonction pour gérer une expiration : recul exponentiel, renvoie 1 s'il faut abandonner la session
+int expiration_rtt(struct estimateur_rtt *e) {
+    compter(&compteurs()->expirations, 1);
+    e->attente += e->rto;
+    e->rto = 2 * e->rto > e->rto_max ? e->rto_max : 2 * e->rto;
+    return e->attente >= MAX_TENTATIVES * e->rto_max;
+}
+
+// Fonction pour armer le délai de retransmission, après un envoi ou une progression du transfert
+void armer_rtt(struct estimateur_rtt *e) {
+    e->echeance = maintenant_us() + e->rto;
+}
+
+// Fonction pour reporter sur le socket le temps restant avant l'échéance, seulement s'il a changé
+void appliquer_rto(int sockfd, struct estimateur_rtt *e) {
+    // Les doublons et les ACK périmés ne repoussent pas l'échéance : après eux, seul le temps restant est attendu
+    long delai = e->rto;
+    if (e->echeance != 0) {
+        long restant = e->echeance - maintenant_us();
+        if (restant < e->rto - GRANULARITE_US) {
+            delai = restant > 0 ? restant : 1;
+        }
+    }
+    if (delai != e->rto_applique) {
+        struct timeval tv;
+        tv.tv_sec = delai / 1000000;
+        tv.tv_usec = delai % 1000000;
+        if (setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+            erreur("Erreur lors de la configuration du timeout");
+        }
+        e->rto_applique = delai;
+    }
+}
+
+// Fonction pour initialiser la fenêtre d'envoi avec les options négociées, avant le premier bloc
+void initialiser_envoi(struct fenetre_envoi *f, const struct options_tftp *options) {
+    f->windowsize = options->windowsize;
+    f->rollover = options->rollover;
+    f->dernier_ack = 0;
+    f->prochain_bloc = 1;
+    f->dernier_bloc = 0;
+    f->plus_haut_envoye = 0;
+    f->bloc_mesure = 0;
+    f->instant_mesure = 0;
+    f->avance_recue = 0;
+}
+
+// Fonction pour savoir si le prochain bloc tient dans la fenêtre et dans le fichier
+int bloc_a_envoyer(const struct fenetre_envoi *f) {
+    return f->prochain_bloc <= f->dernier_ack + f->windowsize && (f->dernier_bloc == 0 || f->prochain_bloc <= f->dernier_bloc);
+}
+
+// Fonction pour noter l'envoi, à l'instant donné, des blocs premier_envoye à prochain_bloc - 1.
+// Renvoie le nombre de retransmissions
+long fenetre_envoyee(struct fenetre_envoi *f, long premier_envoye, long instant) {
+    // Les blocs jusqu'au plus haut déjà envoyé sont des retransmissions
+    long dernier_renvoye = f->prochain_bloc - 1 < f->plus_haut_envoye ? f->prochain_bloc - 1 : f->plus_haut_envoye;
+    long nb_retransmis = dernier_renvoye >= premier_envoye ? dernier_renvoye - premier_envoye + 1 : 0;
+    if (f->prochain_bloc - 1 > f->plus_haut_envoye) {
+        // Fenêtre terminée par un bloc neuf : son ACK mesure un aller-retour sans ambiguïté (règle de Karn)
+        if (f->bloc_mesure == 0) {
+            f->bloc_mesure = f->prochain_bloc - 1;
+            f->instant_mesure = instant;
+        }
+        f->plus_haut_envoye = f->prochain_bloc - 1;
+    }
+    return nb_retransmis;
+}
+
+// Fonction pour prendre en compte un ACK cumulatif, qui peut acquitter jusqu'au bloc plafond, renvoie son avance.
+// Les ACK en double ou périmés (avance 0) sont ignorés pour éviter le syndrome de l'apprenti sorcier
+long accepter_ack(struct fenetre_envoi *f, unsigned short bloc_recu, long plafond) {
+    // Avance de l'ACK par rapport au dernier bloc acquitté, en tenant compte du repli des numéros
+    long avance = avance_bloc(f->dernier_ack, bloc_recu, f->rollover);
+    if (avance < 1 || avance > plafond - f->dernier_ack) {
+        return 0;
+    }
+    f->dernier_ack += avance;
+    f->avance_recue = 1;
+    if (f->dernier_ack >= f->prochain_bloc) {
+        f->prochain_bloc = f->dernier_ack + 1;
+    }
+    return avance;
+}
+
+// Fonction pour conclure un lot d'ACK avant d'envoyer la fenêtre suivante : mesure du RTT, puis reprise
+// après le dernier bloc acquitté si un ACK partiel signale un trou. Renvoie le nombre de blocs à renvoyer
+long conclure_acks(struct fenetre_envoi *f, struct estimateur_rtt *rtt) {
+    if (f->bloc_mesure != 0 && f->dernier_ack >= f->bloc_mesure) {
+        mesurer_rtt(rtt, maintenant_us() - f->instant_mesure);
+        f->bloc_mesure = 0;
+    }
+    long a_renvoyer = 0;
+    if (f->avance_recue && f->dernier_ack < f->prochain_bloc - 1) {
+        a_renvoyer = f->prochain_bloc - 1 - f->dernier_ack;
+        f->prochain_bloc = f->dernier_ack + 1;
+        f->bloc_mesure = 0;
+    }
+    f->avance_recue = 0;
+    return a_renvoyer;
+}
+
+// Fonction pour reprendre l'envoi après le bloc donné (expiration, changement de maître d'un groupe),
+// les blocs renvoyés ne servant pas à mesurer le RTT
+void reprendre_envoi(struct fenetre_envoi *f, long dernier_ack) {
+    f->dernier_ack = dernier_ack;
+    f->prochain_bloc = dernier_ack + 1;
+    f->bloc_mesure = 0;
+}
+
+// Fonction pour initialiser le contrôle de congestion. Sans contrôle, la fenêtre reste celle négociée
+void initialiser_congestion(struct controle_congestion *c, int mode, int windowsize) {
+    c->mode = mode;
+    c->windowsize = windowsize;
+    c->ssthresh = windowsize;
+    c->cwnd = mode == CONGESTION_AUCUN || windowsize < CWND_INITIAL ? windowsize : CWND_INITIAL;
+    c->fin_recuperation = 0;
+    c->rtt_min = 0;
+    c->tendance = 1;
+    c->nb_mesures = 0;
+}
+
+// Fonction pour ajuster la fenêtre après un ACK qui acquitte avance blocs : d'autant en démarrage lent, puis
+// d'un bloc par RTT, en plus en mode AIMD, dans le sens donné par la dernière mesure du RTT en mode délai
+void congestion_ack(struct controle_congestion *c, long avance) {
+    if (c->mode == CONGESTION_AUCUN) {
+        return;
+    }
+    if (c->cwnd < c->ssthresh) {
+        c->cwnd += avance;
+    } else {
+        c->cwnd += (c->mode == CONGESTION_AIMD ? 1 : c->tendance) * avance / c->cwnd;
+    }
+    c->cwnd = c->cwnd > c->windowsize ? c->windowsize : c->cwnd < CWND_MIN ? CWND_MIN : c->cwnd;
+}
+
+// Fonction pour réduire la fenêtre après une perte : de moitié sur un ACK en double ou partiel, au minimum
+// sur une expiration. Tant qu'aucun bloc envoyé après la dernière réduction n'est acquitté, les pertes sont
+// déjà prises en compte. Renvoie 1 si la fenêtre a été réduite
+int congestion_perte(struct controle_congestion *c, const struct fenetre_envoi *f, int expiration) {
+    if (c->mode == CONGESTION_AUCUN || (!expiration && f->dernier_ack <= c->fin_recuperation)) {
+        return 0;
+    }
+    c->ssthresh = c->cwnd / 2 > CWND_MIN ? c->cwnd / 2 : CWND_MIN;
+    c->cwnd = expiration ? CWND_MIN : c->ssthresh;
+    if (c->cwnd > c->windowsize) {
+        c->cwnd = c->windowsize;
+    }
+    c->fin_recuperation = f->plus_haut_envoye;
+    return 1;
+}
+
+// Fonction pour orienter la fenêtre sur le délai de file d'attente, à chaque nouvelle mesure du RTT (Vegas) :
+// l'écart entre le RTT mesuré et le RTT minimal estime le nombre de blocs de la session en file d'attente
+void congestion_delai(struct controle_congestion *c, const struct estimateur_rtt *e) {
+    if (c->mode != CONGESTION_DELAI || e->nb_mesures == c->nb_mesures) {
+        return;
+    }
+    c->nb_mesures = e->nb_mesures;
+    if (c->rtt_min == 0 || e->dernier_rtt < c->rtt_min) {
+        c->rtt_min = e->dernier_rtt;
+    }
+    double en_file = c->cwnd * (e->dernier_rtt - c->rtt_min) / e->dernier_rtt;
+    if (c->cwnd < c->ssthresh && en_file > VEGAS_GAMMA) {
+        c->ssthresh = c->cwnd;
+    }
+    c->tendance = en_file < VEGAS_ALPHA ? 1 : en_file > VEGAS_BETA ? -1 : 0;
+}
+
+// Fonction pour calculer le débit d'envoi, en octets par seconde, qui achemine cwnd blocs par RTT.
+// La fenêtre négociée de W blocs part au débit r puis attend son ACK : un cycle dure W / r + srtt et doit
+// durer W * srtt / cwnd, d'où r = cwnd * W / (srtt * (W - cwnd)). Renvoie 0 si l'envoi n'est pas rythmé :
+// fenêtre de congestion pleine, ou pas encore de mesure du RTT
+long debit_congestion(const struct controle_congestion *c, const struct estimateur_rtt *e, int taille_paquet) {
+    if (c->mode == CONGESTION_AUCUN || c->cwnd >= c->windowsize || e->srtt == 0) {
+        return 0;
+    }
+    double paquets_par_seconde = c->cwnd * c->windowsize * 1e6 / (e->srtt * (c->windowsize - c->cwnd));
+    return (long)(paquets_par_seconde * taille_paquet) + 1;
+}
+
+// Fonction pour initialiser la fenêtre de réception avec les options négociées, avant le premier bloc
+void initialiser_reception(struct fenetre_reception *f, const struct options_tftp *options) {
+    f->windowsize = options->windowsize;
+    f->rollover = options->rollover;
+    f->numero_bloc = 0;
+    f->recus_fenetre = 0;
+    f->ecart_signale = 0;
+}
+
+// Fonction pour classer un bloc DATA reçu par rapport au dernier bloc reçu dans l'ordre
+int recevoir_bloc(struct fenetre_reception *f, unsigned short bloc_recu) {
+    if (bloc_recu == bloc_sur_fil(f->numero_bloc + 1, f->rollover)) {
+        f->numero_bloc++;
+        f->recus_fenetre++;
+        f->ecart_signale = 0;
+        return BLOC_SUIVANT;
+    }
+    if (bloc_recu == bloc_sur_fil(f->numero_bloc, f->rollover) || !f->ecart_signale) {
+        // Un seul ACK par trou : les blocs suivants de la fenêtre, déjà partis, ne déclenchent pas d'autre renvoi
+        f->recus_fenetre = 0;
+        f->ecart_signale = 1;
+        return BLOC_HORS_SEQUENCE;
+    }
+    return BLOC_IGNORE;
+}
+
+// Fonction pour savoir si la fenêtre est complète, auquel cas l'ACK cumulatif est dû
+int fenetre_complete(struct fenetre_reception *f) {
+    if (f->recus_fenetre >= f->windowsize) {
+        f->recus_fenetre = 0;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Machine à états d'un transfert, indépendante du transport : délai de retransmission (RFC 6298),
+// fenêtre d'envoi d'une lecture et fenêtre de réception d'une écriture (RFC 7440)
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "tftp.h"
+
+#define TIMEOUT_SEC 5        // Délai de retransmission maximal, atteint par recul exponentiel
+#define MAX_TENTATIVES 5     // Abandon après MAX_TENTATIVES délais maximaux sans réponse
+#define RTO_INITIAL_US 1000000L // Délai de retransmission avant la première mesure de RTT (RFC 6298)
+#define RTO_MIN_US 2000L        // Plancher du délai de retransmission adaptatif
+#define GRANULARITE_US 1000L    // Marge minimale au-dessus du RTT lissé
+
+// Résultat de la réception d'un bloc DATA
+#define BLOC_IGNORE 0        // Doublon déjà signalé : rien à faire
+#define BLOC_SUIVANT 1       // Bloc attendu, à écrire
+#define BLOC_HORS_SEQUENCE 2 // Doublon ou trou dans la fenêtre : le dernier bloc reçu dans l'ordre est acquitté
+
+// Contrôle de congestion de l'envoi d'une lecture
+#define CONGESTION_AUCUN 0   // Fenêtre négociée envoyée d'un coup
+#define CONGESTION_AIMD 1    // Démarrage lent puis augmentation additive, réduction de moitié sur perte
+#define CONGESTION_DELAI 2   // Démarrage lent puis ajustement sur le délai de file d'attente (Vegas), réduction sur perte
+#define CWND_MIN 2.0         // Fenêtre de congestion minimale, en blocs : en deçà, deux blocs seraient
+                             // espacés de plus d'un demi-RTT et le destinataire expirerait entre eux
+#define CWND_INITIAL 10.0    // Fenêtre de congestion initiale, en blocs (RFC 6928). Le destinataire n'acquittant
+                             // que la fenêtre négociée complète, la première part entière à ce rythme sans pouvoir
+                             // doubler à chaque RTT : partir de CWND_MIN l'étalerait sur windowsize / 2 RTT
+#define VEGAS_ALPHA 2.0      // Blocs en file d'attente en deçà desquels la fenêtre grandit d'un bloc par RTT
+#define VEGAS_BETA 4.0       // Blocs en file d'attente au-delà desquels elle diminue d'un bloc par RTT
+#define VEGAS_GAMMA 1.0      // Blocs en file d'attente qui mettent fin au démarrage lent
+
+// Estimation du délai de retransmission d'une session (Jacobson/Karels, RFC 6298)
+struct estimateur_rtt {
+    long srtt;              // RTT lissé en microsecondes, 0 avant la première mesure
+    long rttvar;            // Variation du RTT en microsecondes
+    long rto;               // Délai de retransmission courant, doublé à chaque expiration
+    long rto_min;
+    long rto_max;
+    long attente;           // Temps passé à attendre sans progression du transfert
+    long rto_applique;      // Délai actuellement configuré sur le socket
+    long echeance;          // Instant d'expiration du délai de retransmission, 0 s'il n'est pas armé
+    long dernier_rtt;       // Dernière mesure du RTT
+    long nb_mesures;
+};
+
+// Fenêtre d'envoi d'une lecture (RRQ côté serveur, WRQ côté client).
+// Les blocs sont numérotés sans repli : seul leur numéro sur le fil repart à 0 ou 1 après 65535
+struct fenetre_envoi {
+    int windowsize;
+    int rollover;
+    long dernier_ack;       // Dernier bloc acquitté par le destinataire
+    long prochain_bloc;     // Prochain bloc à envoyer
+    long dernier_bloc;      // Numéro du dernier bloc du fichier, 0 tant qu'il n'est pas connu
+    long plus_haut_envoye;  // Bloc le plus loin jamais envoyé, les blocs en deçà sont des retransmissions
+    long bloc_mesure;       // Bloc dont l'ACK donnera la prochaine mesure de RTT, 0 si aucune mesure en cours
+    long instant_mesure;
+    int avance_recue;       // 1 si un ACK du lot en cours a fait avancer la fenêtre
+};
+
+// Fenêtre de congestion d'une lecture, en blocs acquittés par RTT. Le destinataire n'acquitte qu'une fenêtre
+// négociée complète (RFC 7440) : au-dessous de celle-ci, la fenêtre de congestion ne réduit pas le nombre de
+// blocs envoyés mais le rythme auquel ils partent
+struct controle_congestion {
+    int mode;
+    int windowsize;
+    double cwnd;
+    double ssthresh;
+    long fin_recuperation;  // Plus haut bloc envoyé lors de la dernière réduction, qui couvre les pertes jusqu'à lui
+    long rtt_min;           // Plus petit RTT mesuré, sans file d'attente, pour le mode délai
+    int tendance;           // Mode délai : +1, 0 ou -1 bloc par RTT selon la dernière mesure
+    long nb_mesures;        // Mesures du RTT déjà prises en compte
+};
+
+// Fenêtre de réception d'une écriture (WRQ côté serveur, RRQ côté client)
+struct fenetre_reception {
+    int windowsize;
+    int rollover;
+    long numero_bloc;       // Dernier bloc reçu dans l'ordre, numéroté sans repli sur 16 bits
+    int recus_fenetre;      // Blocs reçus depuis le dernier ACK envoyé
+    int ecart_signale;      // 1 si un ACK a déjà été envoyé pour signaler un trou dans la fenêtre
+};
+
+extern const char *noms_congestion[];
+
+long maintenant_us();
+long maintenant_ns();
+void initialiser_rtt(struct estimateur_rtt *e, int timeout);
+void mesurer_rtt(struct estimateur_rtt *e, long mesure);
+void progression_rtt(struct estimateur_rtt *e);
+int expiration_rtt(struct estimateur_rtt *e);
+void armer_rtt(struct estimateur_rtt *e);
+void appliquer_rto(int sockfd, struct estimateur_rtt *e);
+
+void initialiser_envoi(struct fenetre_envoi *f, const struct options_tftp *options);
+int bloc_a_envoyer(const struct fenetre_envoi *f);
+long fenetre_envoyee(struct fenetre_envoi *f, long premier_envoye, long instant);
+long accepter_ack(struct fenetre_envoi *f, unsigned short bloc_recu, long plafond);
+long conclure_acks(struct fenetre_envoi *f, struct estimateur_rtt *rtt);
+void reprendre_envoi(struct fenetre_envoi *f, long dernier_ack);
+
+void initialiser_congestion(struct controle_congestion *c, int mode, int windowsize);
+void congestion_ack(struct controle_congestion *c, long avance);
+int congestion_perte(struct controle_congestion *c, const struct fenetre_envoi *f, int expiration);
+void congestion_delai(struct controle_congestion *c, const struct estimateur_rtt *e);
+long debit_congestion(const struct controle_congestion *c, const struct estimateur_rtt *e, int taille_paquet);
+
+void initialiser_reception(struct fenetre_reception *f, const struct options_tftp *options);
+int recevoir_bloc(struct fenetre_reception *f, unsigned short bloc_recu);
+int fenetre_complete(struct fenetre_reception *f);
+
+#endif
@@ -0,0 +1,380 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "tftp.h"
+#include "metriques.h"
+
+// Fonction pour gérer les erreurs et quitter le programme
+void erreur(const char *msg) {
+    perror(msg);
+    exit(1);
+}
+
+// Fonction pour convertir un numéro de bloc absolu en numéro sur 16 bits, qui repart à 0 ou 1 après 65535
+unsigned short bloc_sur_fil(long numero_bloc, int rollover) {
+    if (rollover == 1 && numero_bloc > 0) {
+        return 1 + (numero_bloc - 1) % 65535;
+    }
+    return numero_bloc & 0xFFFF;
+}
+
+// Fonction pour calculer de combien de blocs un numéro reçu sur 16 bits avance par rapport à un bloc absolu
+long avance_bloc(long numero_bloc, unsigned short recu, int rollover) {
+    if (rollover == 1 && numero_bloc > 0) {
+        if (recu == 0) {
+            return 0;
+        }
+        return ((long)recu - bloc_sur_fil(numero_bloc, rollover) + 65535) % 65535;
+    }
+    return (unsigned short)(recu - (numero_bloc & 0xFFFF));
+}
+
+// Fonction pour vérifier qu'un paquet provient bien de l'interlocuteur de la session (même adresse, même TID)
+int meme_client(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// Fonction pour envoyer un ACK ; un échec n'interrompt pas la session, le délai de retransmission le rattrape
+void envoyer_ack(int sockfd, const struct sockaddr_in *destination, int numero_bloc) {
+    struct tftp_ack_packet ack_packet;
+    ack_packet.opcode = htons(OPCODE_ACK);
+    ack_packet.block_num = htons(numero_bloc);
+    if (sendto(sockfd, &ack_packet, sizeof(ack_packet), 0, (const struct sockaddr *)destination, sizeof(struct sockaddr_in)) < 0) {
+        perror("Erreur lors de l'envoi de l'ACK");
+    }
+}
+
+// Fonction pour envoyer un paquet d'erreur
+void envoyer_erreur(int sockfd, const struct sockaddr_in *destination, int code, const char *message) {
+    char buffer[TAILLE_PAQUET];
+    buffer[0] = 0;
+    buffer[1] = OPCODE_ERROR;
+    buffer[2] = 0;
+    buffer[3] = code;
+    snprintf(buffer + 4, sizeof(buffer) - 4, "%s", message);
+    compter(&compteurs()->erreurs_envoyees[code], 1);
+    sendto(sockfd, buffer, strlen(buffer + 4) + 5, 0, (const struct sockaddr *)destination, sizeof(struct sockaddr_in));
+}
+
+// Fonction pour lire un entier de 16 bits en ordre réseau, octet par octet, quel que soit l'alignement du tampon
+unsigned short lire_16bits(const char *octets) {
+    return (unsigned char)octets[0] << 8 | (unsigned char)octets[1];
+}
+
+// Fonction pour lire l'opcode d'un paquet reçu, renvoie 0 (opcode invalide) si le paquet est trop court
+int lire_opcode(const char *paquet, int taille) {
+    return taille >= 2 ? lire_16bits(paquet) : 0;
+}
+
+// Fonction pour lire une chaîne terminée par un zéro avant la fin du paquet, renvoie 0 si ce zéro manque
+int lire_chaine(const char **courant, const char *fin, struct vue_chaine *vue) {
+    const char *zero = memchr(*courant, '\0', fin - *courant);
+    if (zero == NULL) {
+        return 0;
+    }
+    vue->texte = *courant;
+    vue->longueur = zero - *courant;
+    *courant = zero + 1;
+    return 1;
+}
+
+// Fonction pour lire les paires option/valeur jusqu'à la fin du paquet, renvoie -1 si une paire est incomplète.
+// Des zéros de bourrage après la dernière paire sont tolérés
+int lire_options(const char *courant, const char *fin, struct paquet_decode *p) {
+    p->nb_options = 0;
+    struct vue_option option;
+    while (courant < fin) {
+        if (!lire_chaine(&courant, fin, &option.nom)) {
+            return -1;
+        }
+        if (option.nom.longueur == 0) {
+            while (courant < fin && *courant == '\0') {
+                courant++;
+            }
+            return courant == fin ? 0 : -1;
+        }
+        if (!lire_chaine(&courant, fin, &option.valeur)) {
+            return -1;
+        }
+        if (p->nb_options < NB_OPTIONS_MAX) {
+            p->options[p->nb_options++] = option;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour décoder un paquet reçu sans copie, renvoie -1 si sa longueur ou son contenu ne respecte pas le protocole.
+// Les vues pointent dans le paquet, dont les chaînes sont vérifiées terminées par un zéro avant sa fin
+int decoder_paquet(const char *paquet, int taille, struct paquet_decode *p) {
+    const char *fin = paquet + taille;
+    const char *courant;
+    p->opcode = lire_opcode(paquet, taille);
+    switch (p->opcode) {
+    case OPCODE_DATA:
+        if (taille < 4) {
+            return -1;
+        }
+        p->bloc = lire_16bits(paquet + 2);
+        p->donnees = paquet + 4;
+        p->taille_donnees = taille - 4;
+        return 0;
+    case OPCODE_ACK:
+        if (taille != 4) {
+            return -1;
+        }
+        p->bloc = lire_16bits(paquet + 2);
+        return 0;
+    case OPCODE_ERROR:
+        if (taille < 5) {
+            return -1;
+        }
+        p->code_erreur = lire_16bits(paquet + 2);
+        courant = paquet + 4;
+        return lire_chaine(&courant, fin, &p->message) ? 0 : -1;
+    case OPCODE_RRQ:
+    case OPCODE_WRQ:
+        // Nom de fichier non vide, mode connu (RFC 1350), puis options éventuelles (RFC 2347)
+        courant = paquet + 2;
+        if (!lire_chaine(&courant, fin, &p->nom_fichier) || p->nom_fichier.longueur == 0 || !lire_chaine(&courant, fin, &p->mode)) {
+            return -1;
+        }
+        if (strcasecmp(p->mode.texte, "octet") != 0 && strcasecmp(p->mode.texte, "netascii") != 0 && strcasecmp(p->mode.texte, "mail") != 0) {
+            return -1;
+        }
+        return lire_options(courant, fin, p);
+    case OPCODE_OACK:
+        return lire_options(paquet + 2, fin, p);
+    }
+    return -1;
+}
+
+// Fonction pour initialiser les options à leurs valeurs sans négociation, aucune option n'étant demandée
+void initialiser_options(struct options_tftp *options) {
+    memset(options, 0, sizeof(*options));
+    options->windowsize = 1;
+    options->blksize = BLKSIZE_DEFAUT;
+    options->maitre = -1;
+}
+
+// Fonction pour appliquer les valeurs par défaut quand le serveur ignore les options (réponse sans OACK)
+void options_par_defaut(struct options_tftp *options) {
+    initialiser_options(options);
+    options->tsize = -1;
+}
+
+// Fonction pour savoir si au moins une option est demandée, auquel cas un OACK précède le transfert
+int options_negociees(const struct options_tftp *options) {
+    return options->windowsize_negocie || options->blksize_negocie || options->timeout_negocie ||
+           options->tsize_negocie || options->rollover_negocie || options->multicast_negocie;
+}
+
+// Fonction pour écrire un champ terminé par un octet nul à la position taille, sans dépasser TAILLE_PAQUET.
+// Renvoie la nouvelle taille du paquet, ou -1 si le champ ne tient pas (ou si un champ précédent n'a pas tenu)
+static int ecrire_champ(char *buffer, int taille, const char *format, ...) {
+    if (taille < 0 || taille >= TAILLE_PAQUET) {
+        return -1;
+    }
+    va_list arguments;
+    va_start(arguments, format);
+    int longueur = vsnprintf(buffer + taille, TAILLE_PAQUET - taille, format, arguments);
+    va_end(arguments);
+    // L'octet nul final doit lui aussi tenir dans le paquet
+    if (longueur < 0 || longueur >= TAILLE_PAQUET - taille) {
+        return -1;
+    }
+    return taille + longueur + 1;
+}
+
+// Fonction pour écrire les options négociées à partir de la position taille, renvoie la nouvelle taille du paquet,
+// ou -1 si les options ne tiennent pas dans TAILLE_PAQUET
+int ecrire_options(char *buffer, int taille, const struct options_tftp *options) {
+    if (options->windowsize_negocie) {
+        taille = ecrire_champ(buffer, taille, "windowsize");
+        taille = ecrire_champ(buffer, taille, "%d", options->windowsize);
+    }
+    if (options->blksize_negocie) {
+        taille = ecrire_champ(buffer, taille, "blksize");
+        taille = ecrire_champ(buffer, taille, "%d", options->blksize);
+    }
+    if (options->timeout_negocie) {
+        taille = ecrire_champ(buffer, taille, "timeout");
+        taille = ecrire_champ(buffer, taille, "%d", options->timeout);
+    }
+    if (options->tsize_negocie) {
+        taille = ecrire_champ(buffer, taille, "tsize");
+        taille = ecrire_champ(buffer, taille, "%lld", options->tsize);
+    }
+    if (options->rollover_negocie) {
+        taille = ecrire_champ(buffer, taille, "rollover");
+        taille = ecrire_champ(buffer, taille, "%d", options->rollover);
+    }
+    if (options->multicast_negocie) {
+        taille = ecrire_champ(buffer, taille, "multicast");
+        taille = ecrire_champ(buffer, taille, "%s", options->multicast);
+    }
+    return taille;
+}
+
+// Fonction pour construire une requête RRQ/WRQ en mode octet avec les options demandées dans un tampon de
+// TAILLE_PAQUET octets, renvoie sa taille ou -1 si le nom de fichier et les options n'y tiennent pas
+int construire_requete(char *buffer, int opcode, const char *nom_fichier, const struct options_tftp *options) {
+    buffer[0] = 0;
+    buffer[1] = opcode;
+    int taille = ecrire_champ(buffer, 2, "%s", nom_fichier);
+    taille = ecrire_champ(buffer, taille, "octet");
+    return ecrire_options(buffer, taille, options);
+}
+
+// Fonction pour construire le paquet OACK avec les options acceptées, retourne 0 si aucune option n'est à acquitter.
+// Les six options avec leurs valeurs bornées tiennent toujours dans TAILLE_PAQUET
+int construire_oack(char *buffer, const struct options_tftp *options) {
+    buffer[0] = 0;
+    buffer[1] = OPCODE_OACK;
+    int taille = ecrire_options(buffer, 2, options);
+    return taille > 2 ? taille : 0;
+}
+
+// Fonction pour fixer, d'après les options d'une requête RRQ/WRQ décodée, les valeurs acceptées par le serveur.
+// Les options inconnues ou hors limites sont ignorées. L'option multicast est seulement relevée :
+// le serveur la retire s'il n'a pas de groupe à proposer
+void analyser_requete(const struct paquet_decode *requete, struct options_tftp *options) {
+    initialiser_options(options);
+    for (int i = 0; i < requete->nb_options; i++) {
+        const char *nom_option = requete->options[i].nom.texte;
+        const char *valeur = requete->options[i].valeur.texte;
+        if (strcasecmp(nom_option, "windowsize") == 0) {
+            int windowsize = atoi(valeur);
+            if (windowsize >= 1 && windowsize <= 65535) {
+                options->windowsize = windowsize > WINDOWSIZE_MAX ? WINDOWSIZE_MAX : windowsize;
+                options->windowsize_negocie = 1;
+            }
+        } else if (strcasecmp(nom_option, "blksize") == 0) {
+            int blksize = atoi(valeur);
+            if (blksize >= BLKSIZE_MIN) {
+                options->blksize = blksize > BLKSIZE_MAX ? BLKSIZE_MAX : blksize;
+                options->blksize_negocie = 1;
+            }
+        } else if (strcasecmp(nom_option, "timeout") == 0) {
+            // Le RFC 2349 n'autorise que 1 à 255 secondes
+            int timeout = atoi(valeur);
+            if (timeout >= 1 && timeout <= 255) {
+                options->timeout = timeout;
+                options->timeout_negocie = 1;
+            }
+        } else if (strcasecmp(nom_option, "tsize") == 0) {
+            // RRQ : le client envoie 0 et le serveur répond la taille du fichier ; WRQ : taille annoncée par le client
+            long long tsize = strtoll(valeur, NULL, 10);
+            if (tsize >= 0) {
+                options->tsize = tsize;
+                options->tsize_negocie = 1;
+            }
+        } else if (strcasecmp(nom_option, "rollover") == 0) {
+            int rollover = atoi(valeur);
+            if (rollover == 0 || rollover == 1) {
+                options->rollover = rollover;
+                options->rollover_negocie = 1;
+            }
+        } else if (strcasecmp(nom_option, "multicast") == 0) {
+            // Le client envoie une valeur vide, l'adresse du groupe est choisie par le serveur
+            options->multicast_negocie = 1;
+        }
+    }
+}
+
+// Fonction pour lire la valeur "adresse,port,maître" de l'option multicast d'un OACK, renvoie 0 si elle est absente
+// L'adresse et le port sont omis quand le serveur désigne un nouveau maître (",,1")
+int lire_multicast(const char *paquet, int taille, struct options_tftp *options) {
+    struct paquet_decode oack;
+    if (decoder_paquet(paquet, taille, &oack) < 0 || oack.opcode != OPCODE_OACK) {
+        return 0;
+    }
+    for (int i = 0; i < oack.nb_options; i++) {
+        if (strcasecmp(oack.options[i].nom.texte, "multicast") != 0) {
+            continue;
+        }
+        char copie[64];
+        snprintf(copie, sizeof(copie), "%s", oack.options[i].valeur.texte);
+        char *port = strchr(copie, ',');
+        char *maitre = port != NULL ? strchr(port + 1, ',') : NULL;
+        if (maitre == NULL) {
+            return 0;
+        }
+        *port++ = '\0';
+        *maitre++ = '\0';
+        if (copie[0] != '\0' && inet_pton(AF_INET, copie, &options->groupe.sin_addr) != 1) {
+            return 0;
+        }
+        if (*port != '\0') {
+            options->groupe.sin_port = htons(atoi(port));
+        }
+        options->maitre = atoi(maitre) == 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Fonction pour retenir parmi les options demandées celles que le serveur accepte dans son OACK.
+// Une option absente, ou renvoyée avec une valeur que le client n'a pas demandée, est refusée
+void analyser_oack(const char *paquet, int taille, struct options_tftp *options) {
+    // Un OACK mal formé n'accepte aucune option
+    struct paquet_decode oack;
+    if (decoder_paquet(paquet, taille, &oack) < 0) {
+        oack.nb_options = 0;
+    }
+    struct options_tftp proposees;
+    initialiser_options(&proposees);
+    for (int i = 0; i < oack.nb_options; i++) {
+        const char *nom_option = oack.options[i].nom.texte;
+        const char *valeur = oack.options[i].valeur.texte;
+        if (strcasecmp(nom_option, "windowsize") == 0) {
+            proposees.windowsize = atoi(valeur);
+            proposees.windowsize_negocie = 1;
+        } else if (strcasecmp(nom_option, "blksize") == 0) {
+            proposees.blksize = atoi(valeur);
+            proposees.blksize_negocie = 1;
+        } else if (strcasecmp(nom_option, "timeout") == 0) {
+            proposees.timeout = atoi(valeur);
+            proposees.timeout_negocie = 1;
+        } else if (strcasecmp(nom_option, "tsize") == 0) {
+            proposees.tsize = strtoll(valeur, NULL, 10);
+            proposees.tsize_negocie = 1;
+        } else if (strcasecmp(nom_option, "rollover") == 0) {
+            proposees.rollover = atoi(valeur);
+            proposees.rollover_negocie = 1;
+        }
+    }
+    // Le serveur peut réduire la fenêtre et la taille de bloc, pas les agrandir
+    options->windowsize_negocie = options->windowsize_negocie && proposees.windowsize_negocie &&
+                                  proposees.windowsize >= 1 && proposees.windowsize <= options->windowsize;
+    options->windowsize = options->windowsize_negocie ? proposees.windowsize : 1;
+    options->blksize_negocie = options->blksize_negocie && proposees.blksize_negocie &&
+                               proposees.blksize >= BLKSIZE_MIN && proposees.blksize <= options->blksize;
+    options->blksize = options->blksize_negocie ? proposees.blksize : BLKSIZE_DEFAUT;
+    // Le serveur doit renvoyer le délai demandé à l'identique (RFC 2349), sinon le délai reste adaptatif
+    options->timeout_negocie = options->timeout_negocie && proposees.timeout_negocie && proposees.timeout == options->timeout;
+    options->timeout = options->timeout_negocie ? proposees.timeout : 0;
+    // Sur une lecture, tsize donne la taille du fichier ; sur une écriture, le serveur renvoie celle annoncée
+    options->tsize_negocie = options->tsize_negocie && proposees.tsize_negocie && proposees.tsize >= 0;
+    options->tsize = options->tsize_negocie ? proposees.tsize : -1;
+    // Sans accord sur rollover, le numéro de bloc repasse à 0 après 65535
+    options->rollover_negocie = options->rollover_negocie && proposees.rollover_negocie && proposees.rollover == options->rollover;
+    options->rollover = options->rollover_negocie ? proposees.rollover : 0;
+    // Sans option multicast dans l'OACK, le transfert se fait en unicast
+    if (!options->multicast_negocie || !lire_multicast(paquet, taille, options) || options->groupe.sin_port == 0) {
+        options->multicast_negocie = 0;
+        options->maitre = -1;
+    }
+}
+
+// Fonction pour agrandir les tampons du socket afin qu'une fenêtre complète tienne dans le noyau
+void dimensionner_tampons(int sockfd, const struct options_tftp *options) {
+    int taille = options->windowsize * (options->blksize + 4) * 2;
+    if (taille > 65536) {
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &taille, sizeof(taille));
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &taille, sizeof(taille));
+    }
+}
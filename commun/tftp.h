@@ -0,0 +1,110 @@
+// Cœur du protocole TFTP commun aux serveurs et au client : paquets, options (RFC 2347) et numéros de bloc
+#ifndef TFTP_H
+#define TFTP_H
+
+#include <netinet/in.h>
+
+#define TAILLE_PAQUET 516  // Requête, ACK, ERROR, OACK, ou DATA avec la taille de bloc par défaut
+
+#define OPCODE_RRQ 1
+#define OPCODE_WRQ 2
+#define OPCODE_DATA 3
+#define OPCODE_ACK 4
+#define OPCODE_ERROR 5
+#define OPCODE_OACK 6
+
+#define WINDOWSIZE_MAX 64  // Taille de fenêtre maximale acceptée par les serveurs (RFC 7440 autorise jusqu'à 65535)
+#define BLKSIZE_DEFAUT 512 // Taille de bloc sans option blksize (RFC 1350)
+#define BLKSIZE_MIN 8
+#define BLKSIZE_MAX 65464  // Taille de bloc maximale autorisée par le RFC 2348
+#define NB_CODES_ERREUR 9  // Codes d'erreur TFTP 0 à 8 (RFC 1350 et RFC 2347)
+#define NB_OPTIONS_MAX 16  // Paires option/valeur retenues par requête ou OACK, les suivantes sont ignorées
+
+// Structure du paquet DATA, alloué avec la taille de bloc négociée
+struct tftp_data_packet {
+    unsigned short opcode;
+    unsigned short block_num;
+    char data[];
+};
+
+// Structure du paquet ACK
+struct tftp_ack_packet {
+    unsigned short opcode;
+    unsigned short block_num;
+};
+
+// Vue sur une chaîne d'un paquet reçu, sans copie : elle pointe dans le tampon de réception
+// et se termine par un zéro situé à l'intérieur du paquet
+struct vue_chaine {
+    const char *texte;
+    int longueur;
+};
+
+// Paire option/valeur d'une requête ou d'un OACK
+struct vue_option {
+    struct vue_chaine nom;
+    struct vue_chaine valeur;
+};
+
+// Paquet reçu décodé sans copie ni allocation, valable tant que le tampon de réception n'est pas réutilisé.
+// Seuls les champs du type de paquet indiqué par l'opcode sont renseignés
+struct paquet_decode {
+    int opcode;
+    unsigned short bloc;            // DATA et ACK
+    unsigned short code_erreur;     // ERROR
+    struct vue_chaine nom_fichier;  // RRQ et WRQ
+    struct vue_chaine mode;         // RRQ et WRQ : netascii, octet ou mail
+    struct vue_chaine message;      // ERROR
+    const char *donnees;            // DATA
+    int taille_donnees;
+    int nb_options;                 // RRQ, WRQ et OACK
+    struct vue_option options[NB_OPTIONS_MAX];
+};
+
+// Options d'une requête ou d'un OACK (RFC 2347).
+// Serveur : les champs *_negocie indiquent les options demandées par le client, reprises dans l'OACK.
+// Client : les options à demander, puis après l'OACK celles acceptées par le serveur
+struct options_tftp {
+    int windowsize;         // Nombre de blocs envoyés avant d'attendre un ACK (RFC 7440)
+    int windowsize_negocie;
+    int blksize;            // Nombre d'octets de données par bloc (RFC 2348)
+    int blksize_negocie;
+    int timeout;            // Délai de retransmission fixe en secondes (RFC 2349), 0 pour le délai adaptatif
+    int timeout_negocie;
+    long long tsize;        // Taille du fichier transféré (RFC 2349), -1 si le client ne la connaît pas
+    int tsize_negocie;
+    int rollover;           // Numéro de bloc qui suit 65535 : 0 ou 1
+    int rollover_negocie;
+    int multicast_negocie;  // Option multicast (RFC 2090)
+    char multicast[48];     // Valeur de l'option : "adresse,port,maître" dans l'OACK, vide dans la requête
+    int maitre;             // Client : 1 si maître du groupe multicast, 0 sinon, -1 sans multicast
+    struct sockaddr_in groupe; // Client : adresse et port du groupe multicast
+};
+
+void erreur(const char *msg);
+
+unsigned short bloc_sur_fil(long numero_bloc, int rollover);
+long avance_bloc(long numero_bloc, unsigned short recu, int rollover);
+int meme_client(const struct sockaddr_in *a, const struct sockaddr_in *b);
+
+void envoyer_ack(int sockfd, const struct sockaddr_in *destination, int numero_bloc);
+void envoyer_erreur(int sockfd, const struct sockaddr_in *destination, int code, const char *message);
+
+unsigned short lire_16bits(const char *octets);
+int lire_opcode(const char *paquet, int taille);
+int lire_chaine(const char **courant, const char *fin, struct vue_chaine *vue);
+int lire_options(const char *courant, const char *fin, struct paquet_decode *p);
+int decoder_paquet(const char *paquet, int taille, struct paquet_decode *p);
+
+void initialiser_options(struct options_tftp *options);
+void options_par_defaut(struct options_tftp *options);
+int options_negociees(const struct options_tftp *options);
+int ecrire_options(char *buffer, int taille, const struct options_tftp *options);
+int construire_requete(char *buffer, int opcode, const char *nom_fichier, const struct options_tftp *options);
+int construire_oack(char *buffer, const struct options_tftp *options);
+void analyser_requete(const struct paquet_decode *requete, struct options_tftp *options);
+int lire_multicast(const char *paquet, int taille, struct options_tftp *options);
+void analyser_oack(const char *paquet, int taille, struct options_tftp *options);
+void dimensionner_tampons(int sockfd, const struct options_tftp *options);
+
+#endif
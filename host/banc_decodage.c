@@ -0,0 +1,257 @@
+// Banc d'essai du décodeur de paquets (commun/tftp.c) : mutation aléatoire d'un corpus de paquets pour vérifier
+// qu'aucune vue ne sort du paquet reçu, puis mesure du temps de décodage par paquet.
+//
+//     make host/banc_decodage
+//     ./host/banc_decodage [-n mutations] [-b decodages] [-s graine] [-c repertoire_corpus]
+//
+// L'option -c écrit le corpus initial, un fichier par paquet, pour un fuzzer externe (AFL, libFuzzer).
+// Chaque paquet muté est copié dans un tampon alloué à sa taille exacte : sous valgrind ou avec
+// -fsanitize=address, une lecture au-delà du paquet est détectée.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tftp.h"
+#include "session.h"
+
+#define TAILLE_MAX_MUTATION 1024 // Taille maximale d'un paquet muté, au-delà de TAILLE_PAQUET pour les requêtes longues
+
+// Paquet du corpus initial
+struct graine_corpus {
+    const char *nom;
+    char octets[TAILLE_PAQUET];
+    int taille;
+};
+
+unsigned long long etat_alea;
+
+// Générateur xorshift64* : rapide, reproductible et indépendant de rand()
+unsigned long long tirer() {
+    etat_alea ^= etat_alea >> 12;
+    etat_alea ^= etat_alea << 25;
+    etat_alea ^= etat_alea >> 27;
+    return etat_alea * 0x2545F4914F6CDD1DULL;
+}
+
+// Fonction pour ajouter au corpus un paquet donné octet par octet
+void ajouter_brut(struct graine_corpus *corpus, int *nb, const char *nom, const char *octets, int taille) {
+    corpus[*nb].nom = nom;
+    memcpy(corpus[*nb].octets, octets, taille);
+    corpus[*nb].taille = taille;
+    (*nb)++;
+}
+
+// Fonction pour construire le corpus initial : un paquet de chaque type, valide ou à la limite du protocole
+int construire_corpus(struct graine_corpus *corpus) {
+    int nb = 0;
+    struct options_tftp options;
+    initialiser_options(&options);
+    corpus[nb].nom = "rrq";
+    corpus[nb].taille = construire_requete(corpus[nb].octets, OPCODE_RRQ, "fichier.bin", &options);
+    nb++;
+
+    options.windowsize = 16;
+    options.windowsize_negocie = 1;
+    options.blksize = 1428;
+    options.blksize_negocie = 1;
+    options.timeout = 2;
+    options.timeout_negocie = 1;
+    options.tsize_negocie = 1;
+    options.rollover_negocie = 1;
+    options.multicast_negocie = 1;
+    corpus[nb].nom = "rrq_options";
+    corpus[nb].taille = construire_requete(corpus[nb].octets, OPCODE_RRQ, "pxelinux.0", &options);
+    nb++;
+    options.multicast_negocie = 0;
+    options.tsize = 1048576;
+    corpus[nb].nom = "wrq_options";
+    corpus[nb].taille = construire_requete(corpus[nb].octets, OPCODE_WRQ, "depot/image.iso", &options);
+    nb++;
+    corpus[nb].nom = "oack";
+    corpus[nb].taille = construire_oack(corpus[nb].octets, &options);
+    nb++;
+
+    ajouter_brut(corpus, &nb, "rrq_netascii_bourrage", "\0\1a\0NetAscii\0\0\0", 15);
+    ajouter_brut(corpus, &nb, "ack", "\0\4\0\7", 4);
+    ajouter_brut(corpus, &nb, "data", "\0\3\1\0donnees", 11);
+    ajouter_brut(corpus, &nb, "data_vide", "\0\3\0\1", 4);
+    ajouter_brut(corpus, &nb, "erreur", "\0\5\0\1Fichier introuvable", 24);
+    ajouter_brut(corpus, &nb, "oack_multicast", "\0\6multicast\000239.1.2.3,7100,1\0", 29);
+    ajouter_brut(corpus, &nb, "rrq_sans_mode", "\0\1fichier\0", 10);
+    ajouter_brut(corpus, &nb, "rrq_option_incomplete", "\0\1a\0octet\0blksize\0", 18);
+    ajouter_brut(corpus, &nb, "ack_long", "\0\4\0\1\0", 5);
+    return nb;
+}
+
+// Fonction pour vérifier qu'une vue est contenue dans le paquet et terminée par un zéro avant sa fin
+int vue_valide(const struct vue_chaine *vue, const char *paquet, int taille) {
+    return vue->texte >= paquet && vue->longueur >= 0 && vue->texte + vue->longueur < paquet + taille &&
+           vue->texte[vue->longueur] == '\0' && (int)strlen(vue->texte) == vue->longueur;
+}
+
+// Fonction pour vérifier les invariants d'un paquet décodé, renvoie 0 si l'un d'eux est violé
+int verifier_decodage(const struct paquet_decode *p, const char *paquet, int taille) {
+    switch (p->opcode) {
+    case OPCODE_RRQ:
+    case OPCODE_WRQ:
+        if (!vue_valide(&p->nom_fichier, paquet, taille) || p->nom_fichier.longueur == 0 || !vue_valide(&p->mode, paquet, taille)) {
+            return 0;
+        }
+        break;
+    case OPCODE_DATA:
+        return p->donnees == paquet + 4 && p->taille_donnees == taille - 4;
+    case OPCODE_ACK:
+        return taille == 4;
+    case OPCODE_ERROR:
+        return vue_valide(&p->message, paquet, taille);
+    case OPCODE_OACK:
+        break;
+    default:
+        return 0;
+    }
+    if (p->nb_options < 0 || p->nb_options > NB_OPTIONS_MAX) {
+        return 0;
+    }
+    for (int i = 0; i < p->nb_options; i++) {
+        if (!vue_valide(&p->options[i].nom, paquet, taille) || p->options[i].nom.longueur == 0 ||
+            !vue_valide(&p->options[i].valeur, paquet, taille)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Fonction pour muter un paquet : octets remplacés, zéros insérés ou retirés, troncature ou extension
+int muter(char *paquet, int taille) {
+    int nb_mutations = 1 + tirer() % 4;
+    for (int m = 0; m < nb_mutations; m++) {
+        int position = taille > 0 ? tirer() % taille : 0;
+        switch (tirer() % 6) {
+        case 0:
+            if (taille > 0) {
+                paquet[position] = tirer();
+            }
+            break;
+        case 1:
+            if (taille > 0) {
+                paquet[position] = '\0';
+            }
+            break;
+        case 2:
+            if (taille > 0 && paquet[position] == '\0') {
+                paquet[position] = 'x';
+            }
+            break;
+        case 3:
+            taille = position;
+            break;
+        case 4:
+            if (taille < TAILLE_MAX_MUTATION) {
+                paquet[taille++] = tirer() % 2 ? '\0' : 'a' + tirer() % 26;
+            }
+            break;
+        case 5:
+            // Opcode tiré parmi les valeurs valides et leurs voisines
+            if (taille >= 2) {
+                paquet[0] = tirer() % 8 == 0 ? 1 : 0;
+                paquet[1] = tirer() % 8;
+            }
+            break;
+        }
+    }
+    return taille;
+}
+
+// Fonction pour écrire le corpus initial dans un répertoire, un fichier par paquet
+void ecrire_corpus(const char *repertoire, const struct graine_corpus *corpus, int nb) {
+    if (mkdir(repertoire, 0755) < 0 && access(repertoire, W_OK) < 0) {
+        perror(repertoire);
+        exit(1);
+    }
+    char chemin[512];
+    for (int i = 0; i < nb; i++) {
+        snprintf(chemin, sizeof(chemin), "%s/%s", repertoire, corpus[i].nom);
+        FILE *fichier = fopen(chemin, "wb");
+        if (fichier == NULL) {
+            perror(chemin);
+            exit(1);
+        }
+        fwrite(corpus[i].octets, 1, corpus[i].taille, fichier);
+        fclose(fichier);
+    }
+    printf("%d paquets du corpus écrits dans %s\n", nb, repertoire);
+}
+
+int main(int argc, char *argv[]) {
+    long nb_mutations = 1000000;
+    long nb_decodages = 2000000;
+    unsigned long long graine = 1;
+    char *repertoire_corpus = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:s:c:")) != -1) {
+        if (opt == 'n') {
+            nb_mutations = atol(optarg);
+        } else if (opt == 'b') {
+            nb_decodages = atol(optarg);
+        } else if (opt == 's') {
+            graine = strtoull(optarg, NULL, 10);
+        } else if (opt == 'c') {
+            repertoire_corpus = optarg;
+        } else {
+            printf("Usage: %s [-n mutations] [-b decodages] [-s graine] [-c repertoire_corpus]\n", argv[0]);
+            exit(1);
+        }
+    }
+    etat_alea = graine * 0x9E3779B97F4A7C15ULL + 1;
+
+    struct graine_corpus corpus[32];
+    int nb_graines = construire_corpus(corpus);
+    if (repertoire_corpus != NULL) {
+        ecrire_corpus(repertoire_corpus, corpus, nb_graines);
+    }
+
+    // Mutations : chaque paquet est décodé depuis un tampon de sa taille exacte
+    struct paquet_decode decode;
+    char mutation[TAILLE_MAX_MUTATION];
+    long nb_acceptes = 0;
+    for (long i = 0; i < nb_mutations; i++) {
+        const struct graine_corpus *g = &corpus[tirer() % nb_graines];
+        memcpy(mutation, g->octets, g->taille);
+        int taille = muter(mutation, g->taille);
+        char *paquet = malloc(taille > 0 ? taille : 1);
+        memcpy(paquet, mutation, taille);
+        if (decoder_paquet(paquet, taille, &decode) == 0) {
+            nb_acceptes++;
+            if (!verifier_decodage(&decode, paquet, taille)) {
+                printf("Invariant violé par une mutation de '%s' (graine %llu, itération %ld, %d octets)\n", g->nom, graine, i, taille);
+                exit(1);
+            }
+            if (decode.opcode == OPCODE_RRQ || decode.opcode == OPCODE_WRQ) {
+                struct options_tftp options;
+                analyser_requete(&decode, &options);
+            }
+        }
+        free(paquet);
+    }
+    printf("%ld mutations décodées sans erreur, %ld acceptées comme paquets valides\n", nb_mutations, nb_acceptes);
+
+    // Mesure du temps de décodage de chaque paquet valide du corpus
+    for (int g = 0; g < nb_graines; g++) {
+        if (decoder_paquet(corpus[g].octets, corpus[g].taille, &decode) < 0 || nb_decodages <= 0) {
+            continue;
+        }
+        volatile int opcodes = 0;
+        long debut = maintenant_ns();
+        for (long i = 0; i < nb_decodages; i++) {
+            decoder_paquet(corpus[g].octets, corpus[g].taille, &decode);
+            opcodes += decode.opcode;
+        }
+        long duree = maintenant_ns() - debut;
+        printf("%-24s %4d octets %3d options : %6.1f ns/paquet\n", corpus[g].nom, corpus[g].taille,
+               decode.opcode == OPCODE_RRQ || decode.opcode == OPCODE_WRQ || decode.opcode == OPCODE_OACK ? decode.nb_options : 0,
+               (double)duree / nb_decodages);
+    }
+    return 0;
+}
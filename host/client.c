@@ -1,39 +1,51 @@
+#define _GNU_SOURCE // sendmmsg, fallocate
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <time.h>
+#include <netinet/udp.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <ftw.h>
+#include <signal.h>
+#include "tftp.h"
+#include "session.h"
 
-#define TAILLE_BUFFER 516
-#define TIMEOUT_SECONDES 5
-#define MAX_TENTATIVES 5
-
-#define OPCODE_RRQ 1
-#define OPCODE_WRQ 2
-#define OPCODE_DATA 3
-#define OPCODE_ACK 4
-#define OPCODE_ERROR 5
-
-// Structure pour un paquet TFTP
-struct paquet_tftp {
-    unsigned short code_operation;
-    union {
-        unsigned short numero_bloc;
-        unsigned short code_erreur;
-    };
-    char donnees[TAILLE_BUFFER - 4];
-};
+#define TAILLE_LOT 64      // Nombre maximal de paquets DATA envoyés par appel sendmmsg
+#define TAILLE_TAMPON_GRO 65535 // Taille maximale d'un groupe de datagrammes livré par UDP_GRO
+#define MAX_TAILLES_BENCH 32    // Nombre maximal de tailles dans le mélange du banc d'essai
 
-// Structure pour un paquet ACK TFTP
-struct paquet_ack_tftp {
-    unsigned short code_operation;
-    unsigned short numero_bloc;
+// Tampon de réception des paquets DATA : avec UDP_GRO, le noyau peut livrer plusieurs datagrammes de même taille d'un coup
+struct reception {
+    char *tampon;
+    int gro;            // 1 si UDP_GRO est activé sur le socket
+    int taille_segment; // Taille des datagrammes regroupés dans le tampon
+    int position;       // Début du prochain datagramme à traiter
+    int longueur;       // Nombre d'octets reçus dans le tampon
+    long nb_appels;     // Statistiques : nombre d'appels de réception
+    long nb_datagrammes;
 };
 
+// Fonction pour allouer un tampon de réception pouvant contenir un paquet DATA de la taille de bloc demandée
+char *allouer_tampon(int blksize) {
+    int taille = blksize > TAILLE_PAQUET - 4 ? blksize : TAILLE_PAQUET - 4;
+    char *tampon = malloc(sizeof(struct tftp_data_packet) + taille);
+    if (tampon == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    return tampon;
+}
+
 // Fonction pour arrêter le programme avec un message d'erreur
 void arreter(char *s) {
     perror(s);
@@ -54,27 +66,18 @@ int initialiser_socket(struct sockaddr_in *si_serveur, char *ip_serveur, int por
     si_serveur->sin_port = htons(port_serveur);
     si_serveur->sin_addr.s_addr = inet_addr(ip_serveur);
 
-    // Configuration du timeout pour les opérations de réception
-    struct timeval tv;
-    tv.tv_sec = TIMEOUT_SECONDES;
-    tv.tv_usec = 0;
-    if (setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-        arreter("setsockopt");
-    }
-
     return socket_fd;
 }
 
 // Fonction pour envoyer une requête de lecture (RRQ)
-void envoyer_rrq(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier) {
-    char paquet_requete[TAILLE_BUFFER];
-    int longueur_nom_fichier = strlen(nom_fichier);
+void envoyer_rrq(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier, struct options_tftp *options) {
+    char paquet_requete[TAILLE_PAQUET];
     // Construction du paquet RRQ
-    paquet_requete[0] = 0;
-    paquet_requete[1] = OPCODE_RRQ;
-    strcpy(paquet_requete + 2, nom_fichier);
-    strcpy(paquet_requete + 2 + longueur_nom_fichier + 1, "octet");
-    int taille_paquet = longueur_nom_fichier + strlen("octet") + 4;
+    int taille_paquet = construire_requete(paquet_requete, OPCODE_RRQ, nom_fichier, options);
+    if (taille_paquet < 0) {
+        printf("Nom de fichier trop long : la requête et ses options dépassent %d octets.\n", TAILLE_PAQUET);
+        exit(1);
+    }
     // Envoi du paquet au serveur
     if (sendto(socket_fd, paquet_requete, taille_paquet, 0, (struct sockaddr *)si_serveur, sizeof(*si_serveur)) == -1) {
         arreter("sendto()");
@@ -82,186 +85,957 @@ void envoyer_rrq(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichie
 }
 
 // Fonction pour envoyer une requête d'écriture (WRQ)
-void envoyer_wrq(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier) {
-    char paquet_requete[TAILLE_BUFFER];
-    int longueur_nom_fichier = strlen(nom_fichier);
+void envoyer_wrq(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier, struct options_tftp *options) {
+    char paquet_requete[TAILLE_PAQUET];
     // Construction du paquet WRQ
-    paquet_requete[0] = 0;
-    paquet_requete[1] = OPCODE_WRQ;
-    strcpy(paquet_requete + 2, nom_fichier);
-    strcpy(paquet_requete + 2 + longueur_nom_fichier + 1, "octet");
-    int taille_paquet = longueur_nom_fichier + strlen("octet") + 4;
+    int taille_paquet = construire_requete(paquet_requete, OPCODE_WRQ, nom_fichier, options);
+    if (taille_paquet < 0) {
+        printf("Nom de fichier trop long : la requête et ses options dépassent %d octets.\n", TAILLE_PAQUET);
+        exit(1);
+    }
     // Envoi du paquet au serveur
     if (sendto(socket_fd, paquet_requete, taille_paquet, 0, (struct sockaddr *)si_serveur, sizeof(*si_serveur)) == -1) {
         arreter("sendto()");
     }
 }
 
-// Fonction pour recevoir un paquet ACK
-int recevoir_ack(int socket_fd, struct sockaddr_in *si_serveur, struct paquet_ack_tftp *paquet_ack) {
+// Fonction pour recevoir un paquet du serveur (ACK, OACK ou ERROR)
+int recevoir_ack(int socket_fd, struct sockaddr_in *si_serveur, char *tampon) {
     socklen_t longueur_serveur = sizeof(*si_serveur);
-    // Réception du paquet ACK du serveur
-    int octets_recus = recvfrom(socket_fd, paquet_ack, sizeof(*paquet_ack), 0, (struct sockaddr *)si_serveur, &longueur_serveur);
+    // Réception du paquet du serveur, un ACK, un OACK ou une erreur tiennent dans un paquet de taille standard
+    int octets_recus = recvfrom(socket_fd, tampon, TAILLE_PAQUET, 0, (struct sockaddr *)si_serveur, &longueur_serveur);
     if (octets_recus == -1) {
-        perror("recvfrom a échoué");
         return -1;
     }
-    return 0;
+    return octets_recus;
+}
+
+// Fonction pour envoyer d'un coup les paquets préparés, en un seul appel sendmmsg dans le cas courant
+int envoyer_lot(int socket_fd, struct mmsghdr *messages, int nb_paquets) {
+    int envoyes = 0;
+    int nb_appels = 0;
+    while (envoyes < nb_paquets) {
+        int n = sendmmsg(socket_fd, messages + envoyes, nb_paquets - envoyes, 0);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            arreter("sendmmsg");
+        }
+        envoyes += n;
+        nb_appels++;
+    }
+    return nb_appels;
+}
+
+// Fonction pour activer la réception groupée UDP_GRO, renvoie 0 si le noyau ne la supporte pas
+int activer_gro(int socket_fd) {
+    int active = 1;
+    if (setsockopt(socket_fd, SOL_UDP, UDP_GRO, &active, sizeof(active)) == -1) {
+        perror("UDP_GRO non supporté, réception classique");
+        return 0;
+    }
+    return 1;
+}
+
+// Fonction pour recevoir le prochain datagramme, pris dans le dernier groupe UDP_GRO s'il en reste
+int recevoir_datagramme(int socket_fd, struct sockaddr_in *si_serveur, struct reception *r, int taille_max, const char **datagramme) {
+    if (r->position >= r->longueur) {
+        char controle[CMSG_SPACE(sizeof(int))];
+        struct iovec iov;
+        iov.iov_base = r->tampon;
+        iov.iov_len = r->gro ? TAILLE_TAMPON_GRO : taille_max;
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_name = si_serveur;
+        message.msg_namelen = sizeof(*si_serveur);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = controle;
+        message.msg_controllen = sizeof(controle);
+        int octets_recus = recvmsg(socket_fd, &message, 0);
+        if (octets_recus == -1) {
+            return -1;
+        }
+        // Sans information de segmentation, le tampon contient un seul datagramme
+        r->taille_segment = octets_recus;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                memcpy(&r->taille_segment, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+        if (r->taille_segment <= 0) {
+            r->taille_segment = octets_recus;
+        }
+        r->position = 0;
+        r->longueur = octets_recus;
+        r->nb_appels++;
+    }
+    // Chaque segment est un datagramme complet, seul le dernier du groupe peut être plus court
+    *datagramme = r->tampon + r->position;
+    int taille = r->longueur - r->position < r->taille_segment ? r->longueur - r->position : r->taille_segment;
+    r->position += taille;
+    r->nb_datagrammes++;
+    return taille;
 }
 
 // Fonction pour envoyer des données au serveur
-void envoyer_donnees(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier) {
-    struct paquet_ack_tftp paquet_ack;
-    if (recevoir_ack(socket_fd, si_serveur, &paquet_ack) == -1) {
-        arreter("recvfrom a échoué");
+void envoyer_donnees(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier, struct options_tftp *options) {
+    char *tampon_recu = allouer_tampon(0);
+    struct paquet_decode paquet_recu;
+    int octets_recus;
+    struct estimateur_rtt rtt;
+    initialiser_rtt(&rtt, options->timeout);
+    long instant_requete = maintenant_us();
+    int requete_renvoyee = 0; // Pas de mesure de RTT sur une requête renvoyée (règle de Karn)
+    armer_rtt(&rtt);
+
+    // Attente de l'ACK du bloc 0 ou de l'OACK, la WRQ est renvoyée en cas de timeout
+    struct sockaddr_in si_requete = *si_serveur;
+    while (1) {
+        appliquer_rto(socket_fd, &rtt);
+        octets_recus = recevoir_ack(socket_fd, si_serveur, tampon_recu);
+        if (octets_recus == -1) {
+            if (expiration_rtt(&rtt)) {
+                printf("Aucune réponse du serveur après %ld ms, abandon.\n", rtt.attente / 1000);
+                exit(1);
+            }
+            *si_serveur = si_requete;
+            envoyer_wrq(socket_fd, si_serveur, nom_fichier, options);
+            requete_renvoyee = 1;
+            armer_rtt(&rtt);
+            continue;
+        }
+        if (decoder_paquet(tampon_recu, octets_recus, &paquet_recu) < 0) {
+            // Paquet mal formé : ignoré
+            continue;
+        }
+        if (paquet_recu.opcode == OPCODE_OACK || (paquet_recu.opcode == OPCODE_ACK && paquet_recu.bloc == 0)) {
+            if (paquet_recu.opcode == OPCODE_OACK) {
+                analyser_oack(tampon_recu, octets_recus, options);
+            } else {
+                // Le serveur ignore les options : transfert classique pas à pas
+                options_par_defaut(options);
+            }
+            initialiser_rtt(&rtt, options->timeout);
+            if (!requete_renvoyee) {
+                mesurer_rtt(&rtt, maintenant_us() - instant_requete);
+            }
+            break;
+        } else if (paquet_recu.opcode == OPCODE_ERROR) {
+            printf("Le serveur a renvoyé une erreur : %s\n", paquet_recu.message.texte);
+            exit(1);
+        }
     }
+
     FILE *fichier = fopen(nom_fichier, "rb");
     if (fichier == NULL) {
         arreter("fopen");
     }
-    struct paquet_tftp paquet_donnees;
-    int numero_bloc = 1;
-    int tentatives;
+    dimensionner_tampons(socket_fd, options);
+
+    // Une fenêtre part en un seul appel sendmmsg : un paquet préparé par case du lot
+    int taille_lot = options->windowsize < TAILLE_LOT ? options->windowsize : TAILLE_LOT;
+    size_t taille_case = sizeof(struct tftp_data_packet) + options->blksize;
+    char *paquets = malloc(taille_lot * taille_case);
+    struct mmsghdr messages[TAILLE_LOT];
+    struct iovec iov[TAILLE_LOT];
+    if (paquets == NULL) {
+        arreter("malloc");
+    }
+    memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < taille_lot; i++) {
+        iov[i].iov_base = paquets + i * taille_case;
+        messages[i].msg_hdr.msg_name = si_serveur;
+        messages[i].msg_hdr.msg_namelen = sizeof(*si_serveur);
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    long total_paquets = 0; // Statistiques des lots envoyés
+    long nb_appels = 0;
+
+    // Numéros de bloc absolus : seuls les 16 bits de poids faible passent sur le réseau
+    struct fenetre_envoi envoi;
+    initialiser_envoi(&envoi, options);
+    long bloc_fichier = 1;  // Bloc correspondant à la position courante dans le fichier
     int octets_lus;
-    socklen_t longueur_serveur = sizeof(*si_serveur);
 
-    do {
-        // Lecture du fichier
-        octets_lus = fread(paquet_donnees.donnees, 1, TAILLE_BUFFER - 4, fichier);
-        if (octets_lus < 0) {
-            arreter("fread");
+    while (envoi.dernier_bloc == 0 || envoi.dernier_ack < envoi.dernier_bloc) {
+        // Instant d'envoi pris avant la fenêtre : l'ACK peut arriver avant le retour de sendmmsg
+        long debut_fenetre = maintenant_us();
+        long premier_envoye = envoi.prochain_bloc;
+        // Préparation et envoi des blocs de la fenêtre courante
+        int nb_paquets = 0;
+        while (bloc_a_envoyer(&envoi)) {
+            if (bloc_fichier != envoi.prochain_bloc) {
+                // Retour en arrière après une perte
+                fseeko(fichier, (off_t)(envoi.prochain_bloc - 1) * options->blksize, SEEK_SET);
+                bloc_fichier = envoi.prochain_bloc;
+            }
+            struct tftp_data_packet *paquet_donnees = (struct tftp_data_packet *)iov[nb_paquets].iov_base;
+            // Lecture du fichier
+            octets_lus = fread(paquet_donnees->data, 1, options->blksize, fichier);
+            if (octets_lus < options->blksize) {
+                if (ferror(fichier)) {
+                    arreter("fread");
+                }
+                envoi.dernier_bloc = envoi.prochain_bloc;
+            }
+            bloc_fichier++;
+            // Construction du paquet de données
+            paquet_donnees->opcode = htons(OPCODE_DATA);
+            paquet_donnees->block_num = htons(bloc_sur_fil(envoi.prochain_bloc, options->rollover));
+            iov[nb_paquets].iov_len = octets_lus + 4;
+            envoi.prochain_bloc++;
+            // Envoi du lot quand il est plein, les fenêtres plus grandes que le lot partent en plusieurs appels
+            if (++nb_paquets == taille_lot) {
+                nb_appels += envoyer_lot(socket_fd, messages, nb_paquets);
+                total_paquets += nb_paquets;
+                nb_paquets = 0;
+            }
+        }
+        if (nb_paquets > 0) {
+            nb_appels += envoyer_lot(socket_fd, messages, nb_paquets);
+            total_paquets += nb_paquets;
         }
-        // Construction du paquet de données
-        paquet_donnees.code_operation = htons(OPCODE_DATA);
-        paquet_donnees.numero_bloc = htons(numero_bloc);
 
-        tentatives = 0;
+        fenetre_envoyee(&envoi, premier_envoye, debut_fenetre);
+        if (envoi.prochain_bloc > premier_envoye) {
+            // Seul un envoi réarme le délai : un ACK périmé, qui n'ouvre pas la fenêtre, ne retarde pas la retransmission
+            armer_rtt(&rtt);
+        }
 
-        while (tentatives < 3) { // Tentatives limitées à 3 pour éviter une boucle infinie
-            // Envoi du paquet de données au serveur
-            if (sendto(socket_fd, &paquet_donnees, octets_lus + 4, 0, (struct sockaddr *)si_serveur, longueur_serveur) == -1) {
-                arreter("sendto");
+        // Réception de l'ACK cumulatif du serveur
+        appliquer_rto(socket_fd, &rtt);
+        octets_recus = recevoir_ack(socket_fd, si_serveur, tampon_recu);
+        if (octets_recus == -1) {
+            if (expiration_rtt(&rtt)) {
+                printf("Échec de l'envoi après %ld ms sans réponse, abandon.\n", rtt.attente / 1000);
+                fclose(fichier);
+                free(paquets);
+                free(tampon_recu);
+                return;
             }
-            // Réception du paquet ACK du serveur
-            if (recevoir_ack(socket_fd, si_serveur, &paquet_ack) == 0 && paquet_ack.code_operation == htons(OPCODE_ACK) && paquet_ack.numero_bloc == htons(numero_bloc)) {
-                break; // ACK reçu correctement
-            } else {
-                tentatives++;
+            // Timeout : reprise après le dernier bloc acquitté
+            reprendre_envoi(&envoi, envoi.dernier_ack);
+            continue;
+        }
+        if (decoder_paquet(tampon_recu, octets_recus, &paquet_recu) < 0) {
+            continue;
+        }
+        if (paquet_recu.opcode == OPCODE_ACK) {
+            // Un ACK partiel fait reprendre l'envoi après le bloc acquitté
+            if (accepter_ack(&envoi, paquet_recu.bloc, envoi.prochain_bloc - 1) > 0) {
+                progression_rtt(&rtt);
+                conclure_acks(&envoi, &rtt);
             }
+        } else if (paquet_recu.opcode == OPCODE_ERROR) {
+            printf("Le serveur a renvoyé une erreur : %s\n", paquet_recu.message.texte);
+            fclose(fichier);
+            exit(1);
         }
+    }
 
-        if (tentatives == 3) {
-            printf("Échec de l'envoi après 5 tentatives, abandon.\n");
-            fclose(fichier);
-            return;
+    printf("%ld paquets envoyés en %ld appels sendmmsg (%.1f par lot).\n", total_paquets, nb_appels,
+           nb_appels ? (double)total_paquets / nb_appels : 0.0);
+    fclose(fichier);
+    free(paquets);
+    free(tampon_recu);
+}
+
+// Fonction pour recevoir un fichier diffusé à un groupe multicast (RFC 2090)
+// Les blocs arrivent par le groupe dans n'importe quel ordre ; le maître acquitte chaque fenêtre, les autres clients
+// écoutent jusqu'à ce que le serveur les promeuve et reprenne l'envoi au premier bloc qui leur manque
+void recevoir_multicast(int socket_fd, struct sockaddr_in *si_serveur, FILE *fichier, struct options_tftp *options) {
+    // Socket du groupe, partagé avec les autres clients de la même machine
+    int groupe_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (groupe_fd < 0) {
+        arreter("socket()");
+    }
+    int active = 1;
+    setsockopt(groupe_fd, SOL_SOCKET, SO_REUSEADDR, &active, sizeof(active));
+    options->groupe.sin_family = AF_INET;
+    if (bind(groupe_fd, (struct sockaddr *)&options->groupe, sizeof(options->groupe)) < 0) {
+        arreter("bind()");
+    }
+    struct ip_mreq adhesion;
+    adhesion.imr_multiaddr = options->groupe.sin_addr;
+    adhesion.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(groupe_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &adhesion, sizeof(adhesion)) < 0) {
+        arreter("IP_ADD_MEMBERSHIP");
+    }
+    dimensionner_tampons(groupe_fd, options);
+    printf("Réception multicast sur %s:%d (%s).\n", inet_ntoa(options->groupe.sin_addr), ntohs(options->groupe.sin_port),
+           options->maitre ? "maître" : "en attente");
+
+    int taille_paquet = options->blksize + 4;
+    char *tampon = allouer_tampon(options->blksize);
+    struct paquet_decode paquet;
+    // Le serveur n'ouvre un groupe que si les numéros de bloc ne se replient pas
+    long nb_blocs = options->tsize >= 0 ? options->tsize / options->blksize + 1 : 65535;
+    char *recus = calloc(nb_blocs + 1, 1); // Blocs déjà écrits dans le fichier
+    if (recus == NULL) {
+        arreter("calloc");
+    }
+    long premier_manquant = 1; // Premier bloc pas encore reçu
+    long dernier_bloc = 0;     // Numéro du dernier bloc, 0 tant qu'il n'a pas été reçu
+    off_t taille_fichier = 0;
+    int recus_fenetre = 0;     // Maître : paquets reçus depuis le dernier ACK
+    int ecart_signale = 0;     // Maître : 1 si un trou a déjà été signalé
+    long nb_nouveaux = 0;      // Statistiques
+    long nb_doublons = 0;
+    struct estimateur_rtt rtt;
+    initialiser_rtt(&rtt, options->timeout);
+    long instant_envoi = 0;
+    if (options->maitre) {
+        envoyer_ack(socket_fd, si_serveur, 0);
+        instant_envoi = maintenant_us();
+    }
+    armer_rtt(&rtt);
+
+    // Le socket de la requête reçoit les messages du serveur adressés à ce client : promotion ou erreur
+    struct pollfd sources[2] = { { groupe_fd, POLLIN, 0 }, { socket_fd, POLLIN, 0 } };
+    while (dernier_bloc == 0 || premier_manquant <= dernier_bloc) {
+        long restant = rtt.echeance - maintenant_us();
+        struct timespec delai = { 0, 0 };
+        if (restant > 0) {
+            delai.tv_sec = restant / 1000000;
+            delai.tv_nsec = (restant % 1000000) * 1000;
+        }
+        int nb = ppoll(sources, 2, &delai, NULL);
+        if (nb < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            arreter("ppoll()");
+        }
+        if (nb == 0) {
+            // Un client en attente patiente deux fois plus : le serveur met autant de temps que lui à renoncer à un maître disparu
+            if (expiration_rtt(&rtt) && (options->maitre || rtt.attente >= 2 * MAX_TENTATIVES * rtt.rto_max)) {
+                printf("Aucune donnée du groupe après %ld ms, abandon.\n", rtt.attente / 1000);
+                fclose(fichier);
+                close(socket_fd);
+                exit(1);
+            }
+            // Timeout : seul le maître relance le serveur
+            instant_envoi = 0;
+            if (options->maitre) {
+                envoyer_ack(socket_fd, si_serveur, premier_manquant - 1);
+                recus_fenetre = 0;
+            }
+            armer_rtt(&rtt);
+            continue;
         }
 
-        numero_bloc++;
-    } while (octets_lus == TAILLE_BUFFER - 4);
+        struct sockaddr_in source;
+        socklen_t longueur_source = sizeof(source);
+        if (sources[1].revents & POLLIN) {
+            int octets_recus = recvfrom(socket_fd, tampon, taille_paquet, 0, (struct sockaddr *)&source, &longueur_source);
+            if (octets_recus >= 0 && source.sin_port == si_serveur->sin_port && decoder_paquet(tampon, octets_recus, &paquet) == 0) {
+                if (paquet.opcode == OPCODE_ERROR) {
+                    printf("Le serveur a renvoyé une erreur : %s\n", paquet.message.texte);
+                    fclose(fichier);
+                    close(socket_fd);
+                    exit(1);
+                }
+                if (paquet.opcode == OPCODE_OACK && lire_multicast(tampon, octets_recus, options) && options->maitre) {
+                    // Promotion : le serveur reprend l'envoi après le bloc acquitté (OACK répété si l'ACK est perdu)
+                    printf("Promotion en maître du groupe au bloc %ld.\n", premier_manquant);
+                    envoyer_ack(socket_fd, si_serveur, premier_manquant - 1);
+                    recus_fenetre = 0;
+                    ecart_signale = 0;
+                    instant_envoi = maintenant_us();
+                    armer_rtt(&rtt);
+                }
+            }
+        }
+        if (!(sources[0].revents & POLLIN)) {
+            continue;
+        }
 
-    fclose(fichier);
+        // Paquet DATA du groupe, envoyé depuis le TID du serveur (son adresse source peut différer en multicast)
+        longueur_source = sizeof(source);
+        int octets_recus = recvfrom(groupe_fd, tampon, taille_paquet, 0, (struct sockaddr *)&source, &longueur_source);
+        if (octets_recus < 0 || source.sin_port != si_serveur->sin_port || decoder_paquet(tampon, octets_recus, &paquet) < 0 ||
+            paquet.opcode != OPCODE_DATA) {
+            continue;
+        }
+        long bloc = paquet.bloc;
+        if (bloc < 1 || bloc > nb_blocs) {
+            continue;
+        }
+        // Tout bloc du groupe montre que le transfert avance, même un bloc déjà reçu
+        progression_rtt(&rtt);
+        recus_fenetre++;
+        if (!recus[bloc]) {
+            recus[bloc] = 1;
+            nb_nouveaux++;
+            if (pwrite(fileno(fichier), paquet.donnees, paquet.taille_donnees, (off_t)(bloc - 1) * options->blksize) < 0) {
+                arreter("pwrite");
+            }
+            if (paquet.taille_donnees < options->blksize) {
+                dernier_bloc = bloc;
+                taille_fichier = (off_t)(bloc - 1) * options->blksize + paquet.taille_donnees;
+            }
+            if (bloc == premier_manquant) {
+                while (premier_manquant <= nb_blocs && recus[premier_manquant]) {
+                    premier_manquant++;
+                }
+                ecart_signale = 0;
+                if (instant_envoi != 0) {
+                    mesurer_rtt(&rtt, maintenant_us() - instant_envoi);
+                    instant_envoi = 0;
+                }
+            }
+        } else {
+            nb_doublons++;
+        }
+        armer_rtt(&rtt);
+
+        if (!options->maitre || (dernier_bloc != 0 && premier_manquant > dernier_bloc)) {
+            continue;
+        }
+        if (bloc > premier_manquant && !ecart_signale) {
+            // Bloc au-delà d'un trou : acquitter le dernier bloc reçu dans l'ordre
+            envoyer_ack(socket_fd, si_serveur, premier_manquant - 1);
+            recus_fenetre = 0;
+            ecart_signale = 1;
+            instant_envoi = 0;
+        } else if (recus_fenetre >= options->windowsize) {
+            // Fin de fenêtre : l'ACK peut dépasser les blocs envoyés depuis la promotion, déjà reçus auparavant
+            envoyer_ack(socket_fd, si_serveur, premier_manquant - 1);
+            recus_fenetre = 0;
+            instant_envoi = maintenant_us();
+        }
+    }
+
+    // Fichier complet : l'ACK du dernier bloc fait quitter le groupe, et termine le tour du client s'il est maître
+    envoyer_ack(socket_fd, si_serveur, dernier_bloc);
+    if (ftruncate(fileno(fichier), taille_fichier) < 0) {
+        arreter("ftruncate");
+    }
+    printf("%ld blocs reçus par le groupe multicast (%ld doublons).\n", nb_nouveaux, nb_doublons);
+    close(groupe_fd);
+    free(recus);
+    free(tampon);
 }
 
 // Fonction pour recevoir des données du serveur
-void recevoir_donnees(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier) {
+void recevoir_donnees(int socket_fd, struct sockaddr_in *si_serveur, char *nom_fichier, struct options_tftp *options, int gro) {
     FILE *fichier = fopen(nom_fichier, "wb");
     if (fichier == NULL) {
         arreter("fopen");
     }
 
-    struct paquet_tftp paquet_donnees;
-    int numero_bloc = 1;
-    socklen_t longueur_serveur = sizeof(*si_serveur);
+    // Le paquet est dimensionné pour la taille de bloc demandée, le serveur ne peut proposer plus grand
+    const char *datagramme;
+    struct paquet_decode paquet;
+    struct reception r;
+    memset(&r, 0, sizeof(r));
+    r.gro = gro;
+    r.tampon = allouer_tampon(gro ? TAILLE_TAMPON_GRO : options->blksize);
+    int taille_paquet = BLKSIZE_DEFAUT + 4; // Taille d'un paquet DATA complet
+    struct sockaddr_in si_requete = *si_serveur;
+    struct fenetre_reception fenetre;
+    initialiser_reception(&fenetre, options);
+    int reponse_recue = 0; // 1 dès que le serveur a répondu à la requête
+    struct estimateur_rtt rtt;
+    initialiser_rtt(&rtt, options->timeout);
+    long instant_envoi = maintenant_us(); // Envoi de la requête ou du dernier ACK, 0 si aucune mesure de RTT n'est en cours
+    armer_rtt(&rtt);
     int octets_recus;
 
-    do {
+    while (1) {
         // Réception du paquet de données du serveur
-        octets_recus = recvfrom(socket_fd, &paquet_donnees, TAILLE_BUFFER, 0, (struct sockaddr *)si_serveur, &longueur_serveur);
+        appliquer_rto(socket_fd, &rtt);
+        octets_recus = recevoir_datagramme(socket_fd, si_serveur, &r, taille_paquet > TAILLE_PAQUET ? taille_paquet : TAILLE_PAQUET, &datagramme);
         if (octets_recus == -1) {
-            if (errno == EWOULDBLOCK) {
-                printf("Aucune réponse du serveur, nouvelle tentative...\n");
-            } else {
+            if (errno != EWOULDBLOCK) {
                 arreter("recvfrom()");
             }
-        } else {
-            // Vérification du code opération
-            unsigned short code_operation = ntohs(paquet_donnees.code_operation);
-            if (code_operation == OPCODE_ERROR) {
-                printf("Le serveur a renvoyé une erreur : %s\n", paquet_donnees.donnees);
-                fclose(fichier);
-                close(socket_fd);
-                exit(1);
-            } else if (code_operation == OPCODE_ACK) {
-                // ACK reçu du serveur
-            } else if (code_operation != OPCODE_DATA) {
-                printf("Réponse inattendue du serveur.\n");
+            if (expiration_rtt(&rtt)) {
+                printf("Aucune réponse du serveur après %ld ms, abandon.\n", rtt.attente / 1000);
                 fclose(fichier);
                 close(socket_fd);
                 exit(1);
             }
-
-            // Vérification du numéro de bloc
-            unsigned short numero_bloc_recu = ntohs(paquet_donnees.numero_bloc);
-            if (numero_bloc_recu != numero_bloc) {
-                printf("Numéro de bloc inattendu : %d, attendu : %d\n", numero_bloc_recu, numero_bloc);
-                fclose(fichier);
-                close(socket_fd);
-                exit(1);
+            instant_envoi = 0; // Un paquet renvoyé rendrait la mesure ambiguë (règle de Karn)
+            if (!reponse_recue) {
+                // La requête ou sa réponse a été perdue : renvoi de la RRQ
+                *si_serveur = si_requete;
+                envoyer_rrq(socket_fd, si_serveur, nom_fichier, options);
+            } else {
+                envoyer_ack(socket_fd, si_serveur, bloc_sur_fil(fenetre.numero_bloc, options->rollover));
+                fenetre.recus_fenetre = 0;
             }
+            armer_rtt(&rtt);
+            continue;
+        }
+        if (decoder_paquet(datagramme, octets_recus, &paquet) < 0) {
+            // Paquet mal formé : ignoré
+            continue;
+        }
 
-            // Écriture des données dans le fichier
-            fwrite(paquet_donnees.donnees, 1, octets_recus - 4, fichier);
-
-            // Envoi d'un acquittement (ACK) au serveur
-            struct paquet_ack_tftp paquet_ack;
-            paquet_ack.code_operation = htons(OPCODE_ACK);
-            paquet_ack.numero_bloc = htons(numero_bloc);
-            if (sendto(socket_fd, &paquet_ack, 4, 0, (struct sockaddr *)si_serveur, sizeof(*si_serveur)) == -1) {
-                arreter("sendto()");
+        // Vérification du code opération
+        if (paquet.opcode == OPCODE_ERROR) {
+            printf("Le serveur a renvoyé une erreur : %s\n", paquet.message.texte);
+            fclose(fichier);
+            close(socket_fd);
+            exit(1);
+        } else if (paquet.opcode == OPCODE_OACK) {
+            // Options acceptées par le serveur : acquittement par l'ACK du bloc 0
+            if (fenetre.numero_bloc == 0) {
+                analyser_oack(datagramme, octets_recus, options);
+                initialiser_rtt(&rtt, options->timeout);
+                if (instant_envoi != 0) {
+                    mesurer_rtt(&rtt, maintenant_us() - instant_envoi);
+                }
+                initialiser_reception(&fenetre, options);
+                taille_paquet = options->blksize + 4;
+                dimensionner_tampons(socket_fd, options);
+                // Réservation de la taille annoncée par tsize, sans changer la taille du fichier
+                if (options->tsize > 0 && fallocate(fileno(fichier), FALLOC_FL_KEEP_SIZE, 0, options->tsize) < 0 && errno == ENOSPC) {
+                    printf("Espace disque insuffisant pour %lld octets.\n", options->tsize);
+                    envoyer_erreur(socket_fd, si_serveur, 3, "Espace disque insuffisant.");
+                    fclose(fichier);
+                    close(socket_fd);
+                    exit(1);
+                }
+                reponse_recue = 1;
+                if (options->maitre >= 0) {
+                    // Option multicast acceptée : le fichier arrive par le groupe
+                    recevoir_multicast(socket_fd, si_serveur, fichier, options);
+                    break;
+                }
+                envoyer_ack(socket_fd, si_serveur, 0);
+                instant_envoi = maintenant_us();
+                armer_rtt(&rtt);
             }
+            continue;
+        } else if (paquet.opcode != OPCODE_DATA) {
+            printf("Réponse inattendue du serveur.\n");
+            fclose(fichier);
+            close(socket_fd);
+            exit(1);
+        }
+        if (!reponse_recue) {
+            // Premier bloc reçu sans OACK : le serveur ignore les options
+            options_par_defaut(options);
+            initialiser_reception(&fenetre, options);
+            reponse_recue = 1;
+            initialiser_rtt(&rtt, 0);
+        }
 
-            numero_bloc++;
+        // Vérification du numéro de bloc
+        int classement = recevoir_bloc(&fenetre, paquet.bloc);
+        if (classement != BLOC_SUIVANT) {
+            if (classement == BLOC_HORS_SEQUENCE) {
+                // Doublon ou bloc hors séquence : acquitter le dernier bloc reçu dans l'ordre, sans réarmer le délai
+                envoyer_ack(socket_fd, si_serveur, bloc_sur_fil(fenetre.numero_bloc, options->rollover));
+                instant_envoi = 0;
+            }
+            continue;
+        }
+        progression_rtt(&rtt);
+        armer_rtt(&rtt);
+        if (instant_envoi != 0) {
+            // Premier bloc reçu après la requête ou un ACK : un aller-retour
+            mesurer_rtt(&rtt, maintenant_us() - instant_envoi);
+            instant_envoi = 0;
         }
-    } while (octets_recus == TAILLE_BUFFER);
 
-    fclose(fichier);
-}
+        // Écriture des données dans le fichier
+        fwrite(paquet.donnees, 1, paquet.taille_donnees, fichier);
 
-int main(int argc, char *argv[]) {
-    // Vérification du nombre d'arguments et de la commande
-    if (argc != 5 || (strcmp(argv[1], "get") != 0 && strcmp(argv[1], "put") != 0)) {
-        printf("Usage: %s <get/put> <ip_serveur> <port_serveur> <nom_fichier>\n", argv[0]);
-        exit(1);
+        // Envoi d'un acquittement (ACK) au serveur à la fin de chaque fenêtre et sur le dernier bloc
+        if (octets_recus < taille_paquet) {
+            envoyer_ack(socket_fd, si_serveur, bloc_sur_fil(fenetre.numero_bloc, options->rollover));
+            break;
+        }
+        if (fenetre_complete(&fenetre)) {
+            envoyer_ack(socket_fd, si_serveur, bloc_sur_fil(fenetre.numero_bloc, options->rollover));
+            instant_envoi = maintenant_us();
+        }
     }
 
-    char *operation = argv[1];
-    char *ip_serveur = argv[2];
-    int port_serveur = atoi(argv[3]);
-    char *nom_fichier = argv[4];
+    if (gro) {
+        printf("%ld datagrammes reçus en %ld appels recvmsg (%.1f par groupe UDP_GRO).\n", r.nb_datagrammes, r.nb_appels,
+               r.nb_appels ? (double)r.nb_datagrammes / r.nb_appels : 0.0);
+    }
+    fclose(fichier);
+    free(r.tampon);
+}
 
+// Transfert complet d'un fichier : requête, négociation des options et échange des blocs
+void transferer(char *operation, char *ip_serveur, int port_serveur, char *nom_fichier, struct options_tftp options, int gro) {
     // Initialisation du socket
     struct sockaddr_in si_serveur;
     int socket_fd = initialiser_socket(&si_serveur, ip_serveur, port_serveur);
 
+    // Dès qu'une option est demandée, la requête annonce aussi la taille du fichier (RFC 2349)
+    int avec_options = options_negociees(&options);
+
     // Traitement en fonction de la commande (GET ou PUT)
     if (strcmp(operation, "get") == 0) {
-        // Envoi de la requête GET
-        envoyer_rrq(socket_fd, &si_serveur, nom_fichier);
+        // Réception groupée activée avant la requête pour couvrir les premiers blocs
+        if (gro) {
+            gro = activer_gro(socket_fd);
+        }
+        // Envoi de la requête GET, tsize à 0 pour obtenir la taille du fichier
+        if (avec_options) {
+            options.tsize = 0;
+            options.tsize_negocie = 1;
+        }
+        envoyer_rrq(socket_fd, &si_serveur, nom_fichier, &options);
         //sleep(10);
         // Réception des données du serveur
-        recevoir_donnees(socket_fd, &si_serveur, nom_fichier);
+        recevoir_donnees(socket_fd, &si_serveur, nom_fichier, &options, gro);
         printf("Le fichier '%s' a été téléchargé avec succès.\n", nom_fichier);
     } else if (strcmp(operation, "put") == 0) {
-        // Envoi de la requête PUT
-        envoyer_wrq(socket_fd, &si_serveur, nom_fichier);
+        // L'option multicast ne concerne que les lectures
+        options.multicast_negocie = 0;
+        // Envoi de la requête PUT, tsize annonçant la taille du fichier
+        struct stat infos;
+        if (avec_options && stat(nom_fichier, &infos) == 0) {
+            options.tsize = infos.st_size;
+            options.tsize_negocie = 1;
+        }
+        envoyer_wrq(socket_fd, &si_serveur, nom_fichier, &options);
         //sleep(10);
         // Envoi des données au serveur
-        envoyer_donnees(socket_fd, &si_serveur, nom_fichier);
+        envoyer_donnees(socket_fd, &si_serveur, nom_fichier, &options);
         printf("Le fichier '%s' a été envoyé avec succès.\n", nom_fichier);
     }
 
     // Fermeture du socket
     close(socket_fd);
+}
+
+// Mesure d'un transfert du banc d'essai, écrite d'un seul bloc (atomique) dans le tube du processus principal
+struct mesure_bench {
+    long latence_us;
+    long octets;
+    int ecriture;
+    int succes;
+};
+
+// Lecture d'une taille de fichier avec suffixe optionnel k ou M
+long lire_taille(const char *texte) {
+    char *fin;
+    long taille = strtol(texte, &fin, 10);
+    if (*fin == 'k' || *fin == 'K') {
+        taille *= 1024;
+        fin++;
+    } else if (*fin == 'm' || *fin == 'M') {
+        taille *= 1024 * 1024;
+        fin++;
+    }
+    if (fin == texte || *fin != '\0' || taille < 0) {
+        return -1;
+    }
+    return taille;
+}
+
+// Création d'un fichier de contenu aléatoire de la taille demandée
+void creer_fichier_bench(const char *chemin, long taille) {
+    FILE *fichier = fopen(chemin, "wb");
+    if (fichier == NULL) {
+        arreter("fopen");
+    }
+    char bloc[4096];
+    for (long ecrit = 0; ecrit < taille; ecrit += sizeof(bloc)) {
+        for (size_t i = 0; i < sizeof(bloc); i++) {
+            bloc[i] = rand();
+        }
+        long reste = taille - ecrit;
+        fwrite(bloc, 1, reste < (long)sizeof(bloc) ? reste : (long)sizeof(bloc), fichier);
+    }
+    fclose(fichier);
+}
+
+// Fonction pour supprimer une entrée du répertoire de travail du banc, appelée par nftw après son contenu
+int supprimer_entree_bench(const char *chemin, const struct stat *infos, int type, struct FTW *ftw) {
+    (void)infos;
+    (void)type;
+    (void)ftw;
+    if (remove(chemin) < 0) {
+        perror(chemin);
+    }
+    return 0;
+}
+
+// Fonction pour supprimer le répertoire de travail du banc et tout ce qu'il contient
+void supprimer_repertoire_bench(const char *repertoire) {
+    if (chdir("/") < 0 || nftw(repertoire, supprimer_entree_bench, 16, FTW_DEPTH | FTW_PHYS) < 0) {
+        perror(repertoire);
+    }
+}
+
+// Transfert exécuté dans un processus fils, les fonctions du client s'arrêtant par exit() en cas d'erreur :
+// le fils mesure lui-même sa durée (hors fork) et l'écrit dans le tube s'il aboutit
+int transfert_bench(int tube, char *operation, char *ip_serveur, int port_serveur, char *nom_fichier,
+                    struct options_tftp *options, int gro, long taille) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        arreter("fork");
+    }
+    if (pid == 0) {
+        int nul = open("/dev/null", O_WRONLY);
+        dup2(nul, STDOUT_FILENO);
+        dup2(nul, STDERR_FILENO);
+        struct mesure_bench m;
+        long debut = maintenant_us();
+        transferer(operation, ip_serveur, port_serveur, nom_fichier, *options, gro);
+        m.latence_us = maintenant_us() - debut;
+        m.octets = taille;
+        m.ecriture = strcmp(operation, "put") == 0;
+        m.succes = 1;
+        if (write(tube, &m, sizeof(m)) != sizeof(m)) {
+            _exit(1);
+        }
+        exit(0);
+    }
+    int statut;
+    waitpid(pid, &statut, 0);
+    return WIFEXITED(statut) && WEXITSTATUS(statut) == 0;
+}
+
+int comparer_latences(const void *a, const void *b) {
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentile par rang le plus proche sur des latences triées
+long percentile(long *latences, long nb, double p) {
+    long rang = (long)(p * nb + 0.999999) - 1;
+    if (rang < 0) {
+        rang = 0;
+    }
+    return latences[rang < nb ? rang : nb - 1];
+}
+
+// Banc d'essai : nb_clients processus enchaînent des transferts pendant duree secondes, chacun tirant
+// au hasard une taille dans le melange et une écriture avec la probabilité pourcentage_wrq.
+// Le répertoire de travail local est supprimé à la fin, Ctrl-C compris. Les fichiers déposés sur le serveur,
+// bench_<taille> et bench_<taille>_<client>, y restent : TFTP n'a pas de commande de suppression
+void lancer_bench(char *ip_serveur, int port_serveur, struct options_tftp *options, int gro,
+                  int nb_clients, int duree, char *tailles, int pourcentage_wrq) {
+    long melange[MAX_TAILLES_BENCH];
+    int nb_tailles = 0;
+    char *copie = strdup(tailles);
+    for (char *jeton = strtok(copie, ","); jeton != NULL; jeton = strtok(NULL, ",")) {
+        if (nb_tailles == MAX_TAILLES_BENCH || (melange[nb_tailles] = lire_taille(jeton)) < 0) {
+            printf("Mélange de tailles invalide : %s\n", tailles);
+            exit(1);
+        }
+        nb_tailles++;
+    }
+    free(copie);
+    if (nb_tailles == 0) {
+        printf("Mélange de tailles invalide : %s\n", tailles);
+        exit(1);
+    }
+
+    // Répertoire de travail : fichiers sources à la racine, un sous-répertoire par client simulé
+    char repertoire[] = "/tmp/bench_tftp_XXXXXX";
+    if (mkdtemp(repertoire) == NULL || chdir(repertoire) < 0) {
+        arreter("mkdtemp");
+    }
+    int tube[2];
+    if (pipe(tube) < 0) {
+        arreter("pipe");
+    }
+
+    // Dépôt préalable sur le serveur des fichiers lus par les RRQ
+    char nom[64];
+    for (int i = 0; i < nb_tailles; i++) {
+        snprintf(nom, sizeof(nom), "bench_%ld", melange[i]);
+        creer_fichier_bench(nom, melange[i]);
+        if (!transfert_bench(tube[1], "put", ip_serveur, port_serveur, nom, options, gro, melange[i])) {
+            printf("Échec du dépôt de '%s' sur le serveur\n", nom);
+            supprimer_repertoire_bench(repertoire);
+            exit(1);
+        }
+        struct mesure_bench m;
+        if (read(tube[0], &m, sizeof(m)) != sizeof(m)) {
+            arreter("read");
+        }
+    }
+
+    printf("Banc d'essai : %d clients, %d s, tailles %s, %d%% WRQ, blksize %d, windowsize %d\n",
+           nb_clients, duree, tailles, pourcentage_wrq,
+           options->blksize, options->windowsize);
+    fflush(stdout);
+
+    long debut = maintenant_us();
+    long fin = debut + duree * 1000000L;
+    for (int c = 0; c < nb_clients; c++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            arreter("fork");
+        }
+        if (pid > 0) {
+            continue;
+        }
+        close(tube[0]);
+        snprintf(nom, sizeof(nom), "client_%d", c);
+        if (mkdir(nom, 0755) < 0 || chdir(nom) < 0) {
+            _exit(1);
+        }
+        // Fichiers écrits sous un nom propre au client pour ne pas mêler les WRQ concurrentes
+        char noms_wrq[MAX_TAILLES_BENCH][64];
+        for (int i = 0; i < nb_tailles; i++) {
+            snprintf(noms_wrq[i], sizeof(noms_wrq[i]), "bench_%ld_%d", melange[i], c);
+            snprintf(nom, sizeof(nom), "../bench_%ld", melange[i]);
+            if (link(nom, noms_wrq[i]) < 0 && errno != EEXIST) {
+                _exit(1);
+            }
+        }
+        unsigned int graine = getpid();
+        while (maintenant_us() < fin) {
+            int i = rand_r(&graine) % nb_tailles;
+            int ecriture = (int)(rand_r(&graine) % 100) < pourcentage_wrq;
+            snprintf(nom, sizeof(nom), "bench_%ld", melange[i]);
+            if (!transfert_bench(tube[1], ecriture ? "put" : "get", ip_serveur, port_serveur,
+                                 ecriture ? noms_wrq[i] : nom, options, gro, melange[i])) {
+                struct mesure_bench m = {0, melange[i], ecriture, 0};
+                if (write(tube[1], &m, sizeof(m)) != sizeof(m)) {
+                    _exit(1);
+                }
+            }
+        }
+        _exit(0);
+    }
+    close(tube[1]);
+    // Ctrl-C arrête les clients : le processus principal l'ignore pour publier les mesures déjà reçues et nettoyer
+    signal(SIGINT, SIG_IGN);
+
+    // Collecte des mesures jusqu'à la fermeture du tube par le dernier client
+    long capacite = 1024, nb_mesures = 0, nb_echecs = 0, nb_ecritures = 0, octets = 0;
+    long *latences = malloc(capacite * sizeof(long));
+    struct mesure_bench m;
+    while (read(tube[0], &m, sizeof(m)) == sizeof(m)) {
+        if (!m.succes) {
+            nb_echecs++;
+            continue;
+        }
+        if (nb_mesures == capacite) {
+            capacite *= 2;
+            latences = realloc(latences, capacite * sizeof(long));
+        }
+        latences[nb_mesures++] = m.latence_us;
+        octets += m.octets;
+        nb_ecritures += m.ecriture;
+    }
+    while (wait(NULL) > 0) {
+    }
+    double secondes = (maintenant_us() - debut) / 1e6;
+
+    printf("Transferts réussis : %ld (%ld RRQ, %ld WRQ), échecs : %ld\n",
+           nb_mesures, nb_mesures - nb_ecritures, nb_ecritures, nb_echecs);
+    printf("Débit agrégé : %.2f Mo/s, %.1f requêtes/s sur %.2f s\n",
+           octets / secondes / 1e6, nb_mesures / secondes, secondes);
+    if (nb_mesures > 0) {
+        qsort(latences, nb_mesures, sizeof(long), comparer_latences);
+        printf("Latence de transfert : p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+               percentile(latences, nb_mesures, 0.50) / 1e3, percentile(latences, nb_mesures, 0.99) / 1e3,
+               percentile(latences, nb_mesures, 0.999) / 1e3, latences[nb_mesures - 1] / 1e3);
+    }
+    supprimer_repertoire_bench(repertoire);
+    printf("Fichiers bench_<taille> et bench_<taille>_<client> laissés dans le répertoire du serveur, à supprimer sur place\n");
+    free(latences);
+}
+
+int main(int argc, char *argv[]) {
+    struct options_tftp options;
+    initialiser_options(&options);
+
+    // Lecture des options de la ligne de commande
+    int opt;
+    int gro = 0;
+    int nb_clients = 8;
+    int duree = 10;
+    char *tailles = "64k";
+    int pourcentage_wrq = 0;
+    while ((opt = getopt(argc, argv, "w:b:T:r:gmn:d:f:p:")) != -1) {
+        if (opt == 'w') {
+            options.windowsize = atoi(optarg);
+            if (options.windowsize < 1 || options.windowsize > 65535) {
+                printf("Taille de fenêtre invalide : %s\n", optarg);
+                exit(1);
+            }
+            options.windowsize_negocie = 1;
+        } else if (opt == 'b') {
+            options.blksize = atoi(optarg);
+            if (options.blksize < BLKSIZE_MIN || options.blksize > BLKSIZE_MAX) {
+                printf("Taille de bloc invalide : %s\n", optarg);
+                exit(1);
+            }
+            options.blksize_negocie = 1;
+        } else if (opt == 'T') {
+            options.timeout = atoi(optarg);
+            if (options.timeout < 1 || options.timeout > 255) {
+                printf("Timeout invalide : %s\n", optarg);
+                exit(1);
+            }
+            options.timeout_negocie = 1;
+        } else if (opt == 'r') {
+            options.rollover = atoi(optarg);
+            if (options.rollover != 0 && options.rollover != 1) {
+                printf("Rollover invalide : %s\n", optarg);
+                exit(1);
+            }
+            options.rollover_negocie = 1;
+        } else if (opt == 'g') {
+            gro = 1;
+        } else if (opt == 'm') {
+            options.multicast_negocie = 1;
+        } else if (opt == 'n') {
+            nb_clients = atoi(optarg);
+            if (nb_clients < 1) {
+                printf("Nombre de clients invalide : %s\n", optarg);
+                exit(1);
+            }
+        } else if (opt == 'd') {
+            duree = atoi(optarg);
+            if (duree < 1) {
+                printf("Durée invalide : %s\n", optarg);
+                exit(1);
+            }
+        } else if (opt == 'f') {
+            tailles = optarg;
+        } else if (opt == 'p') {
+            pourcentage_wrq = atoi(optarg);
+            if (pourcentage_wrq < 0 || pourcentage_wrq > 100) {
+                printf("Pourcentage de WRQ invalide : %s\n", optarg);
+                exit(1);
+            }
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    // Vérification du nombre d'arguments et de la commande
+    int bench = argc - optind == 3 && strcmp(argv[optind], "bench") == 0;
+    if (!bench && (argc - optind != 4 || (strcmp(argv[optind], "get") != 0 && strcmp(argv[optind], "put") != 0))) {
+        printf("Usage: %s [-w windowsize] [-b blksize] [-T timeout] [-r rollover] [-g] [-m] <get/put> <ip_serveur> <port_serveur> <nom_fichier>\n", argv[0]);
+        printf("       %s [options] [-n clients] [-d durée] [-f tailles] [-p pourcentage_wrq] bench <ip_serveur> <port_serveur>\n", argv[0]);
+        exit(1);
+    }
+
+    char *operation = argv[optind];
+    char *ip_serveur = argv[optind + 1];
+    int port_serveur = atoi(argv[optind + 2]);
+
+    if (bench) {
+        lancer_bench(ip_serveur, port_serveur, &options, gro, nb_clients, duree, tailles, pourcentage_wrq);
+        return 0;
+    }
+
+    transferer(operation, ip_serveur, port_serveur, argv[optind + 3], options, gro);
 
     return 0;
 }
@@ -0,0 +1,146 @@
+#!/bin/sh
+# Banc de pertes : lecture d'un même fichier à travers le mandataire de perturbation, pour chaque taux de perte et
+# chaque taille de fenêtre, avec une graine fixe pour rejouer exactement les mêmes pertes d'une exécution à l'autre.
+# Échoue si un transfert n'aboutit pas, si le fichier reçu diffère, si le débit utile tombe sous 1/RAPPORT_MAX
+# de celui du même transfert sans perte, ou si ce transfert de référence est plus lent que servi par le témoin.
+#
+# Lancé par `make check-perte` depuis la racine du dépôt, et par `make check-congestion` avec -C aimd puis -C delai.
+# Variables d'environnement :
+#   SERVEUR          serveur testé (server/serveur_thread par défaut)
+#   OPTIONS_SERVEUR  options ajoutées au serveur, par exemple "-C aimd"
+#   PERTES           taux de perte en % (0 1 2 5), le premier servant de référence
+#   FENETRES         tailles de fenêtre négociées (1 8)
+#   TAILLE           taille du fichier en octets (1000000)
+#   DELAI            délai ajouté dans chaque sens en ms (2)
+#   GRAINE           graine du générateur de pertes (42)
+#   RAPPORT_MAX      rapport maximal entre le débit de référence et celui avec pertes (4), au dixième près ;
+#                    une liste donne une borne par taux de perte après la référence, la dernière valant pour la suite
+#   TEMOIN           options d'un serveur témoin, par exemple "-C aucun" : pour chaque fenêtre, le transfert de
+#                    référence est rejoué à travers lui et ne doit pas être plus lent (vide : pas de témoin)
+#   MARGE_TEMOIN     écart toléré avec le témoin, en % de son débit (5)
+#   DUREE_MAX        durée maximale d'un transfert en secondes (120)
+#   PORT             port du serveur, le mandataire écoutant sur PORT + 1 et le témoin sur PORT + 2 (7301)
+
+RACINE=$(cd "$(dirname "$0")/.." && pwd)
+SERVEUR=${SERVEUR:-server/serveur_thread}
+PERTES=${PERTES:-"0 1 2 5"}
+FENETRES=${FENETRES:-"1 8"}
+TAILLE=${TAILLE:-1000000}
+DELAI=${DELAI:-2}
+GRAINE=${GRAINE:-42}
+RAPPORT_MAX=${RAPPORT_MAX:-4}
+DUREE_MAX=${DUREE_MAX:-120}
+MARGE_TEMOIN=${MARGE_TEMOIN:-5}
+PORT=${PORT:-7301}
+PORT_MANDATAIRE=$((PORT + 1))
+PORT_TEMOIN=$((PORT + 2))
+
+DOSSIER=$(mktemp -d)
+mkdir "$DOSSIER/serveur" "$DOSSIER/client"
+head -c "$TAILLE" /dev/urandom > "$DOSSIER/serveur/fichier.bin"
+
+# Serveur et témoin lancés depuis leur dossier, qui contient le fichier à lire
+cd "$DOSSIER/serveur" || exit 1
+"$RACINE/$SERVEUR" $OPTIONS_SERVEUR "$PORT" > "$DOSSIER/serveur.log" 2>&1 &
+PID_SERVEUR=$!
+PID_TEMOIN=
+if [ -n "$TEMOIN" ]; then
+    "$RACINE/$SERVEUR" $TEMOIN "$PORT_TEMOIN" > "$DOSSIER/temoin.log" 2>&1 &
+    PID_TEMOIN=$!
+fi
+PID_MANDATAIRE=
+terminer() {
+    kill $PID_SERVEUR $PID_TEMOIN $PID_MANDATAIRE 2> /dev/null
+    wait $PID_SERVEUR $PID_TEMOIN $PID_MANDATAIRE 2> /dev/null
+    rm -rf "$DOSSIER"
+}
+trap terminer EXIT
+trap 'exit 1' INT TERM
+sleep 0.3
+for PID in $PID_SERVEUR $PID_TEMOIN; do
+    if ! kill -0 $PID 2> /dev/null; then
+        echo "Le serveur n'a pas démarré :"
+        cat "$DOSSIER/serveur.log" "$DOSSIER/temoin.log" 2> /dev/null
+        exit 1
+    fi
+done
+
+# Lecture du fichier servi sur le port donné, à travers un mandataire neuf : la même graine donne les mêmes pertes.
+# Fixe CODE (celui du client, -1 si le fichier reçu diffère), DUREE_MS et DEBIT (kbit/s)
+transferer() {
+    "$RACINE/host/perturbation" -l "$PERTE" -D "$DELAI" -s "$GRAINE" "$PORT_MANDATAIRE" 127.0.0.1 "$1" > /dev/null 2>&1 &
+    PID_MANDATAIRE=$!
+    sleep 0.1
+    rm -f fichier.bin
+    DEBUT=$(date +%s%N)
+    timeout "$DUREE_MAX" "$RACINE/host/client" -w "$FENETRE" get 127.0.0.1 "$PORT_MANDATAIRE" fichier.bin > /dev/null 2>&1
+    CODE=$?
+    FIN=$(date +%s%N)
+    kill $PID_MANDATAIRE 2> /dev/null
+    wait $PID_MANDATAIRE 2> /dev/null
+    PID_MANDATAIRE=
+    if [ $CODE -eq 0 ] && ! cmp -s fichier.bin ../serveur/fichier.bin; then
+        CODE=-1
+    fi
+    DUREE_MS=$(((FIN - DEBUT) / 1000000))
+    [ "$DUREE_MS" -gt 0 ] || DUREE_MS=1
+    DEBIT=$((TAILLE * 8 / DUREE_MS))
+}
+
+# Borne en dixièmes : "2.5" donne 25
+dixiemes() {
+    awk -v borne="$1" 'BEGIN { printf "%d", borne * 10 + 0.5 }'
+}
+
+echo "Serveur : $SERVEUR $OPTIONS_SERVEUR, fichier de $TAILLE octets, délai $DELAI ms, graine $GRAINE${TEMOIN:+, témoin $TEMOIN}"
+ECHECS=0
+cd "$DOSSIER/client" || exit 1
+for FENETRE in $FENETRES; do
+    REFERENCE=
+    BORNES=$RAPPORT_MAX
+    for PERTE in $PERTES; do
+        transferer "$PORT"
+        LIGNE="windowsize $FENETRE, perte $PERTE % : $DUREE_MS ms, $DEBIT kbit/s"
+        if [ $CODE -eq -1 ]; then
+            echo "ÉCHEC $LIGNE, fichier reçu différent"
+            ECHECS=$((ECHECS + 1))
+        elif [ $CODE -ne 0 ]; then
+            echo "ÉCHEC $LIGNE, transfert interrompu (code $CODE)"
+            ECHECS=$((ECHECS + 1))
+        elif [ -z "$REFERENCE" ]; then
+            REFERENCE=$DEBIT
+            echo "ok    $LIGNE (référence)"
+            if [ -n "$TEMOIN" ]; then
+                transferer "$PORT_TEMOIN"
+                LIGNE="windowsize $FENETRE, perte $PERTE %, témoin : $DUREE_MS ms, $DEBIT kbit/s"
+                if [ $CODE -ne 0 ]; then
+                    echo "ÉCHEC $LIGNE, transfert du témoin en échec (code $CODE)"
+                    ECHECS=$((ECHECS + 1))
+                elif [ $((REFERENCE * 100)) -lt $((DEBIT * (100 - MARGE_TEMOIN))) ]; then
+                    echo "ÉCHEC $LIGNE, référence de $REFERENCE kbit/s plus de $MARGE_TEMOIN % en dessous"
+                    ECHECS=$((ECHECS + 1))
+                else
+                    echo "ok    $LIGNE"
+                fi
+            fi
+        else
+            # Une borne par taux de perte, la dernière de la liste valant pour les suivants
+            BORNE=${BORNES%% *}
+            BORNES=${BORNES#"$BORNE"}
+            BORNES=${BORNES# }
+            [ -n "$BORNES" ] || BORNES=$BORNE
+            if [ $((DEBIT * $(dixiemes "$BORNE"))) -lt $((REFERENCE * 10)) ]; then
+                echo "ÉCHEC $LIGNE, sous 1/$BORNE des $REFERENCE kbit/s de référence"
+                ECHECS=$((ECHECS + 1))
+            else
+                echo "ok    $LIGNE"
+            fi
+        fi
+    done
+done
+
+if [ $ECHECS -ne 0 ]; then
+    echo "$ECHECS transfert(s) en échec"
+    exit 1
+fi
+echo "Tous les transferts ont abouti"
@@ -0,0 +1,638 @@
+// Couche de perturbation réseau : pertes, duplications, réordonnancements, délai et gigue, tirés d'un générateur
+// pseudo-aléatoire initialisé par une graine pour rejouer exactement le même scénario.
+//
+// Deux usages à partir du même fichier :
+// - dans le processus, en bibliothèque préchargée qui intercepte les envois UDP (sendto, send, sendmsg, sendmmsg) :
+//     gcc -shared -fPIC -o libperturbation.so perturbation.c -lpthread -ldl
+//     LD_PRELOAD=./libperturbation.so TFTP_PERTURBATION="perte=2,dup=0.5,reordre=1,delai=5,gigue=2,graine=42" ./serveur_thread 6969
+//   Les paquets envoyés par l'anneau io_uring (serveur_select -u) ne passent pas par la libc et ne sont pas perturbés.
+// - en mandataire UDP sur la boucle locale, pour les clients et serveurs TFTP standard :
+//     gcc -o perturbation perturbation.c -lpthread -ldl
+//     ./perturbation -l 2 -s 42 7002 127.0.0.1 6969
+#define _GNU_SOURCE // RTLD_NEXT, sendmmsg
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+
+#define TAILLE_DATAGRAMME_MAX 65536
+#define RETARD_REORDRE_US 1000L              // Retard supplémentaire d'un paquet réordonné, dépassé par les suivants
+#define TAILLE_TABLE_DEPARTS 4096            // Derniers départs mémorisés par socket pour la gigue sans réordre
+#define MAX_SESSIONS_PROXY 256
+#define INACTIVITE_PROXY_US 30000000L        // Fermeture d'une session du mandataire après 30 s sans trafic
+
+// Paramètres de perturbation, probabilités en pourcentage et durées en microsecondes
+struct parametres_perturbation {
+    double perte;
+    double duplication;
+    double reordre;
+    long delai_us;
+    long gigue_us;
+    unsigned long long graine;
+};
+
+// Datagramme retenu jusqu'à son échéance ; le cookie du socket évite d'envoyer sur un descripteur réutilisé
+struct paquet_differe {
+    long echeance;
+    unsigned long sequence; // Départage des échéances égales dans l'ordre d'envoi
+    int sockfd;
+    unsigned long long cookie;
+    int orphelin; // Descripteur dupliqué à la fermeture du socket par l'application, fermé après le dernier envoi
+    int flags;
+    struct sockaddr_storage destination;
+    socklen_t taille_destination;
+    size_t taille;
+    char *donnees;
+};
+
+static struct parametres_perturbation params;
+static int perturbation_active = 0;
+static unsigned long long etat_alea;
+static pthread_once_t initialisation = PTHREAD_ONCE_INIT;
+static pthread_mutex_t mutex_perturbation = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_differes;
+static int thread_differes_lance = 0;
+
+// File de priorité (tas binaire) des paquets retardés
+static struct paquet_differe *differes = NULL;
+static size_t nb_differes = 0, capacite_differes = 0;
+static unsigned long prochaine_sequence = 0;
+
+// Dernière échéance par socket : la gigue étale les départs sans les réordonner, seul le réordre les inverse
+static struct {
+    int sockfd;
+    long echeance;
+} derniers_departs[TAILLE_TABLE_DEPARTS];
+
+// Statistiques affichées à la fin du processus
+static long nb_datagrammes = 0, nb_pertes = 0, nb_duplications = 0, nb_reordres = 0, nb_retardes = 0;
+
+static ssize_t (*vrai_sendto)(int, const void *, size_t, int, const struct sockaddr *, socklen_t);
+static ssize_t (*vrai_send)(int, const void *, size_t, int);
+static ssize_t (*vrai_sendmsg)(int, const struct msghdr *, int);
+static int (*vrai_sendmmsg)(int, struct mmsghdr *, unsigned int, int);
+static int (*vrai_close)(int);
+
+static long maintenant_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// Générateur xorshift64* : rapide, reproductible et indépendant de rand()
+static double tirage() {
+    etat_alea ^= etat_alea >> 12;
+    etat_alea ^= etat_alea << 25;
+    etat_alea ^= etat_alea >> 27;
+    return ((etat_alea * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void initialiser_alea(unsigned long long graine) {
+    etat_alea = graine * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+// Lecture de TFTP_PERTURBATION, sous la forme "perte=2,dup=0.5,reordre=1,delai=5,gigue=2,graine=42" (délais en ms)
+static void lire_parametres(const char *texte) {
+    char *copie = strdup(texte);
+    char *reste;
+    for (char *jeton = strtok_r(copie, ",", &reste); jeton != NULL; jeton = strtok_r(NULL, ",", &reste)) {
+        char *egal = strchr(jeton, '=');
+        if (egal == NULL) {
+            fprintf(stderr, "perturbation : paramètre ignoré '%s'\n", jeton);
+            continue;
+        }
+        *egal = '\0';
+        double valeur = strtod(egal + 1, NULL);
+        if (strcmp(jeton, "perte") == 0) {
+            params.perte = valeur;
+        } else if (strcmp(jeton, "dup") == 0) {
+            params.duplication = valeur;
+        } else if (strcmp(jeton, "reordre") == 0) {
+            params.reordre = valeur;
+        } else if (strcmp(jeton, "delai") == 0) {
+            params.delai_us = valeur * 1000;
+        } else if (strcmp(jeton, "gigue") == 0) {
+            params.gigue_us = valeur * 1000;
+        } else if (strcmp(jeton, "graine") == 0) {
+            params.graine = strtoull(egal + 1, NULL, 10);
+        } else {
+            fprintf(stderr, "perturbation : paramètre inconnu '%s'\n", jeton);
+        }
+    }
+    free(copie);
+}
+
+static void afficher_statistiques() {
+    if (perturbation_active) {
+        fprintf(stderr, "perturbation : %ld datagrammes, %ld perdus, %ld dupliqués, %ld réordonnés, %ld retardés\n",
+                nb_datagrammes, nb_pertes, nb_duplications, nb_reordres, nb_retardes);
+    }
+}
+
+// À la sortie du processus, les paquets retenus partent encore, comme ceux qu'un noyau garde en file
+static void vider_differes() {
+    while (1) {
+        pthread_mutex_lock(&mutex_perturbation);
+        size_t restants = nb_differes;
+        pthread_mutex_unlock(&mutex_perturbation);
+        if (restants == 0) {
+            break;
+        }
+        usleep(100);
+    }
+}
+
+// Le fils d'un fork n'hérite pas du thread d'envoi différé : il repart d'une file vide
+static void verrouiller_fork() {
+    pthread_mutex_lock(&mutex_perturbation);
+}
+
+static void deverrouiller_fork() {
+    pthread_mutex_unlock(&mutex_perturbation);
+}
+
+static void reprendre_fils() {
+    for (size_t i = 0; i < nb_differes; i++) {
+        free(differes[i].donnees);
+    }
+    nb_differes = 0;
+    thread_differes_lance = 0;
+    pthread_mutex_unlock(&mutex_perturbation);
+}
+
+static void initialiser_perturbation() {
+    vrai_sendto = dlsym(RTLD_NEXT, "sendto");
+    vrai_send = dlsym(RTLD_NEXT, "send");
+    vrai_sendmsg = dlsym(RTLD_NEXT, "sendmsg");
+    vrai_sendmmsg = dlsym(RTLD_NEXT, "sendmmsg");
+    vrai_close = dlsym(RTLD_NEXT, "close");
+    params.graine = 1;
+    const char *texte = getenv("TFTP_PERTURBATION");
+    if (texte != NULL) {
+        lire_parametres(texte);
+        perturbation_active = 1;
+        atexit(afficher_statistiques);
+        atexit(vider_differes);
+    }
+    initialiser_alea(params.graine);
+    pthread_condattr_t attributs;
+    pthread_condattr_init(&attributs);
+    pthread_condattr_setclock(&attributs, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond_differes, &attributs);
+    pthread_atfork(verrouiller_fork, deverrouiller_fork, reprendre_fils);
+}
+
+// Seuls les sockets UDP sur IP sont perturbés (pas les sockets Unix, par exemple ceux de syslog)
+static int socket_udp(int sockfd) {
+    int domaine, type;
+    socklen_t taille = sizeof(int);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_DOMAIN, &domaine, &taille) < 0) {
+        return 0;
+    }
+    taille = sizeof(int);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_TYPE, &type, &taille) < 0) {
+        return 0;
+    }
+    return type == SOCK_DGRAM && (domaine == AF_INET || domaine == AF_INET6);
+}
+
+static unsigned long long cookie_socket(int sockfd) {
+    unsigned long long cookie = 0;
+    socklen_t taille = sizeof(cookie);
+    getsockopt(sockfd, SOL_SOCKET, SO_COOKIE, &cookie, &taille);
+    return cookie;
+}
+
+static int avant(struct paquet_differe *a, struct paquet_differe *b) {
+    return a->echeance < b->echeance || (a->echeance == b->echeance && a->sequence < b->sequence);
+}
+
+static void echanger(size_t i, size_t j) {
+    struct paquet_differe tmp = differes[i];
+    differes[i] = differes[j];
+    differes[j] = tmp;
+}
+
+// Thread d'envoi des paquets retardés, réveillé à chaque nouvelle échéance plus proche
+static void *envoyer_differes(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&mutex_perturbation);
+    while (1) {
+        if (nb_differes == 0) {
+            pthread_cond_wait(&cond_differes, &mutex_perturbation);
+            continue;
+        }
+        long attente = differes[0].echeance - maintenant_us();
+        if (attente > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += attente / 1000000;
+            ts.tv_nsec += (attente % 1000000) * 1000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&cond_differes, &mutex_perturbation, &ts);
+            continue;
+        }
+        // Retrait de la racine du tas
+        struct paquet_differe p = differes[0];
+        differes[0] = differes[--nb_differes];
+        for (size_t i = 0;;) {
+            size_t plus_tot = i, g = 2 * i + 1, d = 2 * i + 2;
+            if (g < nb_differes && avant(&differes[g], &differes[plus_tot])) {
+                plus_tot = g;
+            }
+            if (d < nb_differes && avant(&differes[d], &differes[plus_tot])) {
+                plus_tot = d;
+            }
+            if (plus_tot == i) {
+                break;
+            }
+            echanger(i, plus_tot);
+            i = plus_tot;
+        }
+        pthread_mutex_unlock(&mutex_perturbation);
+        // Un socket fermé entre-temps vaut une perte : son descripteur a pu être réattribué
+        if (cookie_socket(p.sockfd) == p.cookie) {
+            vrai_sendto(p.sockfd, p.donnees, p.taille, p.flags | MSG_DONTWAIT,
+                        p.taille_destination > 0 ? (struct sockaddr *)&p.destination : NULL, p.taille_destination);
+        }
+        free(p.donnees);
+        pthread_mutex_lock(&mutex_perturbation);
+        if (p.orphelin) {
+            size_t i = 0;
+            while (i < nb_differes && differes[i].sockfd != p.sockfd) {
+                i++;
+            }
+            if (i == nb_differes) {
+                vrai_close(p.sockfd);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Mise en attente d'une copie du datagramme, appelée avec le verrou tenu
+static void differer(int sockfd, const void *donnees, size_t taille, int flags, const struct sockaddr *destination,
+                     socklen_t taille_destination, long retard) {
+    if (!thread_differes_lance) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, envoyer_differes, NULL) != 0) {
+            return;
+        }
+        pthread_detach(thread);
+        thread_differes_lance = 1;
+    }
+    if (nb_differes == capacite_differes) {
+        capacite_differes = capacite_differes ? 2 * capacite_differes : 256;
+        differes = realloc(differes, capacite_differes * sizeof(struct paquet_differe));
+    }
+    struct paquet_differe *p = &differes[nb_differes];
+    p->echeance = maintenant_us() + retard;
+    p->sequence = prochaine_sequence++;
+    p->sockfd = sockfd;
+    p->cookie = cookie_socket(sockfd);
+    p->orphelin = 0;
+    p->flags = flags;
+    p->taille_destination = destination != NULL ? taille_destination : 0;
+    if (p->taille_destination > 0) {
+        memcpy(&p->destination, destination, taille_destination);
+    }
+    p->taille = taille;
+    p->donnees = malloc(taille);
+    memcpy(p->donnees, donnees, taille);
+    // Remontée dans le tas
+    for (size_t i = nb_differes++; i > 0 && avant(&differes[i], &differes[(i - 1) / 2]); i = (i - 1) / 2) {
+        echanger(i, (i - 1) / 2);
+    }
+    pthread_cond_signal(&cond_differes);
+}
+
+// Sort d'un datagramme : perdu, envoyé tout de suite ou retenu, éventuellement en deux exemplaires
+static void perturber(int sockfd, const void *donnees, size_t taille, int flags, const struct sockaddr *destination,
+                      socklen_t taille_destination) {
+    pthread_mutex_lock(&mutex_perturbation);
+    nb_datagrammes++;
+    if (tirage() * 100 < params.perte) {
+        nb_pertes++;
+        pthread_mutex_unlock(&mutex_perturbation);
+        return;
+    }
+    int copies = 1;
+    if (tirage() * 100 < params.duplication) {
+        nb_duplications++;
+        copies = 2;
+    }
+    for (int c = 0; c < copies; c++) {
+        long retard = params.delai_us;
+        if (params.gigue_us > 0) {
+            retard += (long)((2 * tirage() - 1) * params.gigue_us);
+        }
+        int reordonne = tirage() * 100 < params.reordre;
+        if (reordonne) {
+            nb_reordres++;
+            retard += RETARD_REORDRE_US;
+        } else if (retard > 0) {
+            int i = sockfd % TAILLE_TABLE_DEPARTS;
+            long ecart = derniers_departs[i].echeance - maintenant_us();
+            if (derniers_departs[i].sockfd == sockfd && ecart > retard) {
+                retard = ecart;
+            }
+            derniers_departs[i].sockfd = sockfd;
+            derniers_departs[i].echeance = maintenant_us() + retard;
+        }
+        if (retard > 0) {
+            nb_retardes++;
+            differer(sockfd, donnees, taille, flags, destination, taille_destination, retard);
+        } else {
+            vrai_sendto(sockfd, donnees, taille, flags, destination, taille_destination);
+        }
+    }
+    pthread_mutex_unlock(&mutex_perturbation);
+}
+
+// Mise à plat d'un message, découpé en datagrammes quand il porte une taille de segment UDP_SEGMENT
+static ssize_t perturber_message(int sockfd, const struct msghdr *message, int flags) {
+    char tampon[TAILLE_DATAGRAMME_MAX];
+    size_t taille = 0;
+    for (size_t i = 0; i < message->msg_iovlen; i++) {
+        size_t longueur = message->msg_iov[i].iov_len;
+        if (taille + longueur > sizeof(tampon)) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        memcpy(tampon + taille, message->msg_iov[i].iov_base, longueur);
+        taille += longueur;
+    }
+    size_t segment = taille;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR((struct msghdr *)message); cmsg != NULL;
+         cmsg = CMSG_NXTHDR((struct msghdr *)message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_SEGMENT) {
+            uint16_t taille_segment;
+            memcpy(&taille_segment, CMSG_DATA(cmsg), sizeof(taille_segment));
+            if (taille_segment > 0) {
+                segment = taille_segment;
+            }
+        }
+    }
+    size_t position = 0;
+    do {
+        size_t longueur = taille - position < segment ? taille - position : segment;
+        perturber(sockfd, tampon + position, longueur, flags, message->msg_name, message->msg_namelen);
+        position += longueur;
+    } while (position < taille);
+    return taille;
+}
+
+ssize_t sendto(int sockfd, const void *donnees, size_t taille, int flags, const struct sockaddr *destination,
+               socklen_t taille_destination) {
+    pthread_once(&initialisation, initialiser_perturbation);
+    if (!perturbation_active || !socket_udp(sockfd)) {
+        return vrai_sendto(sockfd, donnees, taille, flags, destination, taille_destination);
+    }
+    perturber(sockfd, donnees, taille, flags, destination, taille_destination);
+    return taille;
+}
+
+ssize_t send(int sockfd, const void *donnees, size_t taille, int flags) {
+    pthread_once(&initialisation, initialiser_perturbation);
+    if (!perturbation_active || !socket_udp(sockfd)) {
+        return vrai_send(sockfd, donnees, taille, flags);
+    }
+    perturber(sockfd, donnees, taille, flags, NULL, 0);
+    return taille;
+}
+
+ssize_t sendmsg(int sockfd, const struct msghdr *message, int flags) {
+    pthread_once(&initialisation, initialiser_perturbation);
+    if (!perturbation_active || !socket_udp(sockfd)) {
+        return vrai_sendmsg(sockfd, message, flags);
+    }
+    return perturber_message(sockfd, message, flags);
+}
+
+int sendmmsg(int sockfd, struct mmsghdr *messages, unsigned int nb_messages, int flags) {
+    pthread_once(&initialisation, initialiser_perturbation);
+    if (!perturbation_active || !socket_udp(sockfd)) {
+        return vrai_sendmmsg(sockfd, messages, nb_messages, flags);
+    }
+    for (unsigned int i = 0; i < nb_messages; i++) {
+        ssize_t n = perturber_message(sockfd, &messages[i].msg_hdr, flags);
+        if (n < 0) {
+            return i > 0 ? (int)i : -1;
+        }
+        messages[i].msg_len = n;
+    }
+    return nb_messages;
+}
+
+// Un datagramme déjà « envoyé » part même si l'application ferme son socket juste après (dernier ACK)
+int close(int fd) {
+    pthread_once(&initialisation, initialiser_perturbation);
+    if (perturbation_active) {
+        pthread_mutex_lock(&mutex_perturbation);
+        int copie = -1;
+        for (size_t i = 0; i < nb_differes; i++) {
+            if (differes[i].sockfd == fd && !differes[i].orphelin) {
+                if (copie < 0) {
+                    copie = dup(fd);
+                }
+                if (copie >= 0) {
+                    differes[i].sockfd = copie;
+                    differes[i].orphelin = 1;
+                }
+            }
+        }
+        pthread_mutex_unlock(&mutex_perturbation);
+    }
+    return vrai_close(fd);
+}
+
+// Session du mandataire : un socket tourné vers le client, qui joue le rôle du TID du serveur,
+// et un socket tourné vers le serveur, qui joue celui du TID du client
+struct session_proxy {
+    int active;
+    struct sockaddr_in client;
+    struct sockaddr_in serveur;
+    int vers_client;
+    int vers_serveur;
+    long derniere_activite;
+};
+
+static volatile sig_atomic_t arret_demande = 0;
+
+static void demander_arret(int signal) {
+    (void)signal;
+    arret_demande = 1;
+}
+
+static void erreur(const char *message) {
+    perror(message);
+    exit(1);
+}
+
+static int ouvrir_socket(int port) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        erreur("socket");
+    }
+    struct sockaddr_in adresse;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sin_family = AF_INET;
+    adresse.sin_addr.s_addr = htonl(INADDR_ANY);
+    adresse.sin_port = htons(port);
+    if (bind(sockfd, (struct sockaddr *)&adresse, sizeof(adresse)) < 0) {
+        erreur("bind");
+    }
+    return sockfd;
+}
+
+static void fermer_session_proxy(struct session_proxy *s) {
+    close(s->vers_client);
+    close(s->vers_serveur);
+    s->active = 0;
+}
+
+int main(int argc, char *argv[]) {
+    pthread_once(&initialisation, initialiser_perturbation);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:d:o:D:j:s:")) != -1) {
+        if (opt == 'l') {
+            params.perte = atof(optarg);
+        } else if (opt == 'd') {
+            params.duplication = atof(optarg);
+        } else if (opt == 'o') {
+            params.reordre = atof(optarg);
+        } else if (opt == 'D') {
+            params.delai_us = atof(optarg) * 1000;
+        } else if (opt == 'j') {
+            params.gigue_us = atof(optarg) * 1000;
+        } else if (opt == 's') {
+            params.graine = strtoull(optarg, NULL, 10);
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (argc - optind != 3) {
+        printf("Usage: %s [-l perte%%] [-d duplication%%] [-o reordre%%] [-D delai_ms] [-j gigue_ms] [-s graine] <port_local> <ip_serveur> <port_serveur>\n", argv[0]);
+        exit(1);
+    }
+    if (!perturbation_active) {
+        perturbation_active = 1;
+        atexit(afficher_statistiques);
+    }
+    initialiser_alea(params.graine);
+
+    struct sockaddr_in adresse_serveur;
+    memset(&adresse_serveur, 0, sizeof(adresse_serveur));
+    adresse_serveur.sin_family = AF_INET;
+    adresse_serveur.sin_port = htons(atoi(argv[optind + 2]));
+    if (inet_aton(argv[optind + 1], &adresse_serveur.sin_addr) == 0) {
+        fprintf(stderr, "Adresse du serveur invalide : %s\n", argv[optind + 1]);
+        exit(1);
+    }
+    int ecoute = ouvrir_socket(atoi(argv[optind]));
+    signal(SIGINT, demander_arret);
+    signal(SIGTERM, demander_arret);
+    printf("Mandataire de perturbation sur le port %s vers %s:%s (perte %.2f%%, duplication %.2f%%, réordre %.2f%%, délai %ld us, gigue %ld us, graine %llu)\n",
+           argv[optind], argv[optind + 1], argv[optind + 2], params.perte, params.duplication, params.reordre,
+           params.delai_us, params.gigue_us, params.graine);
+
+    static struct session_proxy sessions[MAX_SESSIONS_PROXY];
+    static char tampon[TAILLE_DATAGRAMME_MAX];
+    struct pollfd descripteurs[1 + 2 * MAX_SESSIONS_PROXY];
+    int index_session[1 + 2 * MAX_SESSIONS_PROXY];
+
+    while (!arret_demande) {
+        int nb = 0;
+        descripteurs[nb].fd = ecoute;
+        descripteurs[nb].events = POLLIN;
+        index_session[nb++] = -1;
+        long maintenant = maintenant_us();
+        for (int i = 0; i < MAX_SESSIONS_PROXY; i++) {
+            if (!sessions[i].active) {
+                continue;
+            }
+            if (maintenant - sessions[i].derniere_activite > INACTIVITE_PROXY_US) {
+                fermer_session_proxy(&sessions[i]);
+                continue;
+            }
+            descripteurs[nb].fd = sessions[i].vers_client;
+            descripteurs[nb].events = POLLIN;
+            index_session[nb++] = i;
+            descripteurs[nb].fd = sessions[i].vers_serveur;
+            descripteurs[nb].events = POLLIN;
+            index_session[nb++] = i;
+        }
+        if (poll(descripteurs, nb, 1000) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            erreur("poll");
+        }
+
+        for (int k = 0; k < nb; k++) {
+            if (!(descripteurs[k].revents & POLLIN)) {
+                continue;
+            }
+            struct sockaddr_in source;
+            socklen_t taille_source = sizeof(source);
+            ssize_t taille = recvfrom(descripteurs[k].fd, tampon, sizeof(tampon), MSG_DONTWAIT, (struct sockaddr *)&source, &taille_source);
+            if (taille < 0) {
+                continue;
+            }
+            if (index_session[k] < 0) {
+                // Nouvelle requête : une session par point d'accès client, recréée à chaque requête
+                int libre = -1;
+                for (int i = 0; i < MAX_SESSIONS_PROXY; i++) {
+                    if (sessions[i].active && sessions[i].client.sin_addr.s_addr == source.sin_addr.s_addr &&
+                        sessions[i].client.sin_port == source.sin_port) {
+                        fermer_session_proxy(&sessions[i]);
+                    }
+                    if (!sessions[i].active && libre < 0) {
+                        libre = i;
+                    }
+                }
+                if (libre < 0) {
+                    fprintf(stderr, "Trop de sessions, requête ignorée\n");
+                    continue;
+                }
+                struct session_proxy *s = &sessions[libre];
+                s->active = 1;
+                s->client = source;
+                s->serveur = adresse_serveur;
+                s->vers_client = ouvrir_socket(0);
+                s->vers_serveur = ouvrir_socket(0);
+                s->derniere_activite = maintenant_us();
+                sendto(s->vers_serveur, tampon, taille, 0, (struct sockaddr *)&s->serveur, sizeof(s->serveur));
+                continue;
+            }
+            struct session_proxy *s = &sessions[index_session[k]];
+            if (!s->active) {
+                continue;
+            }
+            s->derniere_activite = maintenant_us();
+            if (descripteurs[k].fd == s->vers_serveur) {
+                // Le serveur répond depuis son TID : les paquets suivants du client lui sont adressés
+                s->serveur = source;
+                sendto(s->vers_client, tampon, taille, 0, (struct sockaddr *)&s->client, sizeof(s->client));
+            } else if (source.sin_addr.s_addr == s->client.sin_addr.s_addr && source.sin_port == s->client.sin_port) {
+                sendto(s->vers_serveur, tampon, taille, 0, (struct sockaddr *)&s->serveur, sizeof(s->serveur));
+            }
+        }
+    }
+    return 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // sendmmsg/recvmmsg, fallocate
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,49 +7,210 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/time.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/un.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include "tftp.h"
+#include "session.h"
+#include "metriques.h"
+#include "journal.h"
 
-#define TAILLE_PAQUET 516
-#define TIMEOUT_SEC 5
-#define MAX_CLIENTS 10
+#define MAX_CLIENTS 4096     // Taille de la table des sessions
+#define MAX_EVENEMENTS 64
+#define SEAUX_SESSIONS 1024  // Nombre de seaux des tables de hachage des sessions
+#define TAILLE_ROUE 4096     // Nombre d'emplacements de la roue des timers
+#define RESOLUTION_ROUE_US 500 // Durée d'un emplacement de la roue en microsecondes, cadencée par un timerfd
+#define TAILLE_LOT WINDOWSIZE_MAX // Datagrammes par appel sendmmsg/recvmmsg : une fenêtre complète tient dans un lot
 
-#define OPCODE_RRQ 1
-#define OPCODE_WRQ 2
-#define OPCODE_DATA 3
-#define OPCODE_ACK 4
-#define OPCODE_ERROR 5
+#define ENTREES_ANNEAU 4096       // Taille de la file de soumission io_uring (la file de complétion est 4 fois plus grande)
+#define TAILLE_MOITIE_ECRITURE (256 * 1024) // Taille visée des écritures groupées d'une WRQ avec io_uring
+#define ALIGNEMENT_TAMPON 4096
+#define FICHIER_ECOUTE 0          // Descripteur fixe du socket d'écoute, suivi du socket et du fichier de chaque session
+#define NB_FICHIERS_FIXES (1 + 2 * MAX_CLIENTS)
 
-// Fonction pour gérer les erreurs et quitter le programme
-void erreur(const char *msg) {
-    perror(msg);
-    exit(1);
-}
+// Opérations soumises à l'anneau, codées dans les 8 bits de poids fort de l'étiquette (user_data)
+#define OPERATION_REQUETE 1    // recvmsg sur le socket d'écoute
+#define OPERATION_RECEPTION 2  // recvmsg sur le socket d'une session
+#define OPERATION_ENVOI 3      // sendmsg d'un paquet DATA
+#define OPERATION_LECTURE 4    // Lecture d'une tranche du fichier dans une moitié du tampon de la session
+#define OPERATION_ECRITURE 5   // Écriture d'une moitié du tampon de la session dans le fichier
+#define OPERATION_ANNULATION 6 // Annulation des opérations en attente d'une session terminée
+#define OPERATION_TIC 7        // Tic de la roue des timers
+#define OPERATION_SYNCHRONISATION 8 // fdatasync du fichier d'une WRQ
+
+#define DURABILITE_AUCUNE 0     // Les données reçues restent dans le cache de pages du noyau
+#define DURABILITE_FIN 1        // fdatasync avant la publication du fichier reçu
+#define DURABILITE_PERIODIQUE 2 // fdatasync tous les N Mo écrits, puis avant la publication
+
+// États de la machine à états d'une session
+#define SESSION_LIBRE 0
+#define SESSION_ATTENTE_ACK_OACK 1 // RRQ : OACK envoyé, attente de l'ACK du bloc 0
+#define SESSION_ENVOI 2            // RRQ : envoi des fenêtres de blocs
+#define SESSION_RECEPTION 3        // WRQ : réception des blocs
+#define SESSION_FERMETURE 4        // io_uring : session terminée, en attente de ses dernières complétions
 
-// Structure de la requête RRQ/WRQ
-struct tftp_request {
-    unsigned short opcode;
-    char filename[TAILLE_PAQUET - 2];
+#define SESSION_ECOUTE 0xFFFFFFFF // Marqueur epoll du socket d'écoute
+#define SESSION_TIMER 0xFFFFFFFE  // Marqueur epoll du timerfd qui fait tourner la roue
+
+// Paquet DATA soumis à l'anneau : le message doit rester valide jusqu'à la complétion de l'envoi
+struct envoi_paquet {
+    struct msghdr message;
+    struct iovec iov[2];             // En-tête, puis données lues directement dans le tampon de la session
+    struct tftp_ack_packet entete;   // Même en-tête de 4 octets que le paquet DATA
 };
 
-// Structure du paquet DATA
-struct tftp_data_packet {
-    unsigned short opcode;
-    unsigned short block_num;
-    char data[TAILLE_PAQUET - 4];
+// Structure d'une session de transfert, une par client, gérée par la boucle d'événements
+struct session {
+    int etat;
+    int type;                      // OPCODE_RRQ ou OPCODE_WRQ
+    unsigned int id;               // Identifiant de la session dans le journal
+    int sockfd;                    // Socket éphémère de la session (TID du serveur)
+    unsigned short tid;            // Port local du socket de la session, dans l'ordre réseau
+    struct sockaddr_in addr_client;
+    FILE *fichier;
+    char nom_fichier[TAILLE_PAQUET];
+    char chemin_temporaire[TAILLE_PAQUET + 16]; // WRQ : fichier reçu, renommé en nom_fichier après le dernier bloc, vide une fois publié
+    struct options_tftp options;
+    char *tampon;                  // Paquets DATA de la fenêtre à envoyer (RRQ)
+    char oack[TAILLE_PAQUET];
+    int taille_oack;
+    struct estimateur_rtt rtt;
+    long instant_mesure;           // Envoi de l'OACK ou de l'ACK dont la réponse mesurera le RTT, 0 si aucune mesure en cours
+    struct fenetre_envoi envoi;    // RRQ : fenêtre des blocs envoyés et acquittés
+    long bloc_fichier;             // RRQ : bloc correspondant à la position courante dans le fichier
+    struct fenetre_reception recus; // WRQ : blocs reçus dans l'ordre
+    // Statistiques des lots sendmmsg/recvmmsg
+    long appels_envoi;
+    long paquets_envoyes;
+    long appels_reception;
+    long paquets_recus;
+    // Moteur io_uring (option -u) : s->tampon est coupé en deux moitiés utilisées alternativement
+    int operations_en_cours;       // Opérations soumises à l'anneau dont la complétion n'a pas été traitée
+    int tampon_enregistre;         // 1 si s->tampon est enregistré dans l'anneau (lectures et écritures FIXED)
+    size_t taille_moitie;
+    long tranche[2];               // RRQ : tranche de windowsize blocs chargée dans chaque moitié, -1 si aucune
+    long tranche_lue[2];           // RRQ : tranche en cours de lecture dans chaque moitié, -1 si aucune
+    int octets_charges[2];         // RRQ : octets lus dans chaque moitié
+    struct envoi_paquet *envois;   // RRQ : un message par bloc des deux moitiés
+    int relance;                   // RRQ : 1 si la session attend l'envoi de sa fenêtre suivante
+    int moitie_courante;           // WRQ : moitié remplie par la réception
+    size_t remplissage;            // WRQ : octets copiés dans la moitié courante
+    size_t taille_ecriture[2];     // WRQ : taille de l'écriture en cours de chaque moitié, 0 si la moitié est libre
+    off_t position_ecriture;       // WRQ : position dans le fichier de la prochaine moitié écrite
+    int reception_suspendue;       // WRQ : 1 si la réception attend que la moitié courante soit écrite
+    int fin_reception;             // WRQ : dernier bloc reçu, l'ACK final attend la fin des écritures
+    long long depuis_sync;         // WRQ : octets écrits depuis la dernière synchronisation
+    int synchronisation_en_cours;  // WRQ : 1 si un fdatasync de l'anneau n'est pas terminé
+    int fin_synchronisee;          // WRQ : 1 une fois lancée la synchronisation qui précède la publication
+    char *reception;               // Tampon du datagramme en cours de réception
+    struct msghdr message_reception;
+    struct iovec iov_reception;
+    struct sockaddr_in source_reception;
+    // Timer de retransmission, dont l'échéance est celle de l'estimateur (s->rtt.echeance)
+    int emplacement_timer;         // Emplacement dans la roue, -1 si le timer n'est pas armé
+    struct session *suivant_timer;
+    struct session *precedent_timer;
+    // Tables de hachage des sessions ouvertes
+    struct session *suivant_requete; // Seau (client, opcode, nom du fichier)
+    struct session *suivant_tid;     // Seau du TID
 };
 
-// Structure du paquet ACK
-struct tftp_ack_packet {
-    unsigned short opcode;
-    unsigned short block_num;
+// L'état des réacteurs est propre à chaque thread (__thread) : avec -r, chaque cœur a son socket d'écoute,
+// sa table de sessions, sa roue des timers et son anneau, sans verrou entre réacteurs
+// Table des sessions (MAX_CLIENTS entrées, allouée par le réacteur) et roue des timers de retransmission
+__thread struct session *sessions;
+__thread struct session *roue_timers[TAILLE_ROUE];
+// Sessions ouvertes indexées par requête (suppression des doublons) et par TID
+__thread struct session *table_requetes[SEAUX_SESSIONS];
+__thread struct session *table_tid[SEAUX_SESSIONS];
+
+// Requêtes en cours de tous les réacteurs, consultées avant d'ouvrir une session quand -a répartit les paquets
+// par cœur : une requête retransmise peut alors arriver sur un autre réacteur que celui de sa session
+struct requete_partagee {
+    struct sockaddr_in addr_client;
+    int opcode;
+    char nom_fichier[TAILLE_PAQUET];
+    struct requete_partagee *suivant;
+};
+int partage_requetes = 0; // 1 avec -a et plusieurs réacteurs
+struct requete_partagee *requetes_partagees[SEAUX_SESSIONS];
+pthread_mutex_t mutex_requetes = PTHREAD_MUTEX_INITIALIZER;
+__thread int sessions_actives = 0;
+__thread int timers_armes = 0;
+__thread int prochaine_session = 0;
+__thread long dernier_tic = 0;
+// Lots sendmmsg/recvmmsg partagés par toutes les sessions d'un réacteur
+__thread struct mmsghdr messages_envoi[TAILLE_LOT];
+__thread struct iovec iov_envoi[TAILLE_LOT];
+__thread struct mmsghdr messages_reception[TAILLE_LOT];
+__thread struct iovec iov_reception[TAILLE_LOT];
+__thread struct sockaddr_in sources_reception[TAILLE_LOT];
+__thread char (*tampons_reception)[BLKSIZE_MAX + 4]; // TAILLE_LOT tampons, alloués par le réacteur
+
+// Anneau io_uring partagé avec le noyau : files de soumission (SQ) et de complétion (CQ)
+struct anneau_io {
+    int fd;
+    unsigned *sq_tete;
+    unsigned *sq_queue;
+    unsigned *sq_masque;
+    unsigned *sq_tableau;
+    unsigned sq_entrees;
+    unsigned queue_locale;         // Queue des soumissions préparées, publiée au noyau par io_uring_enter
+    unsigned a_soumettre;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_tete;
+    unsigned *cq_queue;
+    unsigned *cq_masque;
+    struct io_uring_cqe *cqes;
+};
+
+int mode_durabilite = DURABILITE_AUCUNE;
+long long intervalle_sync = 0; // Octets écrits entre deux fdatasync en mode périodique
+
+// Moteur d'entrées/sorties demandé (-u) : 1 pour l'anneau io_uring, 0 pour epoll et les appels bloquants sur les fichiers
+int anneau_demande = 0;
+// Moteur effectif du réacteur, qui revient à epoll si io_uring est indisponible
+__thread int mode_anneau = 0;
+__thread struct anneau_io anneau;
+__thread int tampons_enregistrables = 0;      // 1 si la table clairsemée de tampons enregistrés a pu être créée
+__thread struct __kernel_timespec tic_anneau; // Durée du tic de la roue, lue par le noyau jusqu'à la complétion
+__thread int tic_arme = 0;
+__thread int sessions_a_relancer[MAX_CLIENTS]; // Sessions RRQ dont la fenêtre suivante part après le traitement des complétions
+__thread int nb_a_relancer = 0;
+
+// Paramètres d'un réacteur
+struct parametres_reacteur {
+    int sockfd;   // Socket d'écoute du réacteur, membre du groupe SO_REUSEPORT
+    int cpu;      // Cœur sur lequel le thread est épinglé, -1 sans épinglage
 };
 
-// Fonction pour initialiser le socket
-int initialiser_socket(int *sockfd, struct sockaddr_in *addr_serveur, int port) {
+// Fonction pour initialiser le socket, partagé (SO_REUSEPORT) entre plusieurs réacteurs si demandé
+int initialiser_socket(int *sockfd, struct sockaddr_in *addr_serveur, int port, int partage) {
     // Création du socket
     *sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (*sockfd < 0) {
         erreur("Erreur lors de la création du socket");
     }
+    // Le noyau répartit les datagrammes entre les sockets du groupe selon le hachage de l'adresse du client
+    int active = 1;
+    if (partage && setsockopt(*sockfd, SOL_SOCKET, SO_REUSEPORT, &active, sizeof(active)) < 0) {
+        erreur("Erreur lors de l'activation de SO_REUSEPORT");
+    }
 
     // Initialisation de l'adresse du serveur
     memset(addr_serveur, 0, sizeof(*addr_serveur));
@@ -64,217 +226,1447 @@ int initialiser_socket(int *sockfd, struct sockaddr_in *addr_serveur, int port)
     return *sockfd;
 }
 
-// Fonction pour envoyer un paquet de données au client
-void envoyer_paquet_donnees(int sockfd, struct sockaddr_in *addr_client, struct tftp_data_packet *data_packet, int data_size, const char *nom_fichier) {
-    if (sendto(sockfd, data_packet, data_size, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in)) < 0) {
-        erreur("Erreur lors de l'envoi du paquet de données");
+// Fonction pour créer l'anneau io_uring, projeter ses files et enregistrer les descripteurs fixes
+int initialiser_anneau(int sockfd) {
+    struct io_uring_params parametres;
+    memset(&parametres, 0, sizeof(parametres));
+    parametres.flags = IORING_SETUP_CQSIZE;
+    parametres.cq_entries = 4 * ENTREES_ANNEAU;
+    anneau.fd = syscall(__NR_io_uring_setup, ENTREES_ANNEAU, &parametres);
+    if (anneau.fd < 0) {
+        return -1;
+    }
+
+    size_t taille_sq = parametres.sq_off.array + parametres.sq_entries * sizeof(unsigned);
+    size_t taille_cq = parametres.cq_off.cqes + parametres.cq_entries * sizeof(struct io_uring_cqe);
+    int projection_unique = parametres.features & IORING_FEAT_SINGLE_MMAP;
+    if (projection_unique && taille_cq > taille_sq) {
+        taille_sq = taille_cq;
+    }
+    char *sq = mmap(NULL, taille_sq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, anneau.fd, IORING_OFF_SQ_RING);
+    char *cq = sq;
+    if (!projection_unique && sq != MAP_FAILED) {
+        cq = mmap(NULL, taille_cq, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, anneau.fd, IORING_OFF_CQ_RING);
+    }
+    anneau.sqes = mmap(NULL, parametres.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       anneau.fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || anneau.sqes == MAP_FAILED) {
+        close(anneau.fd);
+        return -1;
+    }
+    anneau.sq_tete = (unsigned *)(sq + parametres.sq_off.head);
+    anneau.sq_queue = (unsigned *)(sq + parametres.sq_off.tail);
+    anneau.sq_masque = (unsigned *)(sq + parametres.sq_off.ring_mask);
+    anneau.sq_tableau = (unsigned *)(sq + parametres.sq_off.array);
+    anneau.sq_entrees = parametres.sq_entries;
+    anneau.queue_locale = *anneau.sq_queue;
+    anneau.cq_tete = (unsigned *)(cq + parametres.cq_off.head);
+    anneau.cq_queue = (unsigned *)(cq + parametres.cq_off.tail);
+    anneau.cq_masque = (unsigned *)(cq + parametres.cq_off.ring_mask);
+    anneau.cqes = (struct io_uring_cqe *)(cq + parametres.cq_off.cqes);
+
+    // Table des descripteurs fixes, vide sauf le socket d'écoute : le noyau ne résout plus les descripteurs à chaque opération
+    int *fixes = malloc(NB_FICHIERS_FIXES * sizeof(int));
+    if (fixes == NULL) {
+        erreur("Erreur lors de l'allocation de la table des descripteurs fixes");
+    }
+    for (int i = 0; i < NB_FICHIERS_FIXES; i++) {
+        fixes[i] = -1;
     }
-    if (data_packet->opcode == htons(OPCODE_DATA)) {
-        printf("Envoi des données du fichier '%s' au client...\n", nom_fichier);
-    } else if (data_packet->opcode == htons(OPCODE_ACK)) {
-        printf("Réception de l'ACK du client pour le fichier '%s'\n", nom_fichier);
+    fixes[FICHIER_ECOUTE] = sockfd;
+    int resultat = syscall(__NR_io_uring_register, anneau.fd, IORING_REGISTER_FILES, fixes, NB_FICHIERS_FIXES);
+    free(fixes);
+    if (resultat < 0) {
+        close(anneau.fd);
+        return -1;
     }
+
+    // Table clairsemée de tampons enregistrés, un emplacement par session, remplie à l'ouverture des sessions
+    struct io_uring_rsrc_register enregistrement;
+    memset(&enregistrement, 0, sizeof(enregistrement));
+    enregistrement.nr = MAX_CLIENTS;
+    enregistrement.flags = IORING_RSRC_REGISTER_SPARSE;
+    tampons_enregistrables = syscall(__NR_io_uring_register, anneau.fd, IORING_REGISTER_BUFFERS2, &enregistrement, sizeof(enregistrement)) == 0;
+
+    return 0;
 }
 
-// Fonction pour recevoir une demande d'écriture (WRQ) du client
-int recevoir_wrq(int sockfd, struct sockaddr_in *addr_client, const char *nom_fichier, const char *mode) {
-    printf("Requête d'écriture (WRQ) reçue pour le fichier '%s'\n", nom_fichier);
-    char buffer[TAILLE_PAQUET];
-    socklen_t longueur_client = sizeof(struct sockaddr_in);
-    int numero_bloc = 0;
-    FILE *fichier = fopen(nom_fichier, "w+b"); // Ouverture en mode écriture binaire
-    if (fichier == NULL) {
-        erreur("Erreur lors de l'ouverture du fichier pour l'écriture");
+// Fonction pour transmettre au noyau les opérations préparées et attendre au plus `attente` complétions
+void soumettre_anneau(unsigned attente) {
+    __atomic_store_n(anneau.sq_queue, anneau.queue_locale, __ATOMIC_RELEASE);
+    int soumises = syscall(__NR_io_uring_enter, anneau.fd, anneau.a_soumettre, attente, attente > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (soumises < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            erreur("Erreur lors de l'appel à io_uring_enter()");
+        }
+        return;
     }
+    anneau.a_soumettre -= soumises;
+}
 
-    // Envoi de l'ACK pour WRQ
-    struct tftp_ack_packet ack_packet;
-    ack_packet.opcode = htons(OPCODE_ACK);
-    ack_packet.block_num = htons(0);
+// Fonction pour réserver une entrée de la file de soumission
+struct io_uring_sqe *obtenir_sqe() {
+    while (anneau.queue_locale - __atomic_load_n(anneau.sq_tete, __ATOMIC_ACQUIRE) >= anneau.sq_entrees) {
+        // File pleine : on la transmet au noyau sans attendre de complétion
+        soumettre_anneau(0);
+    }
+    unsigned position = anneau.queue_locale & *anneau.sq_masque;
+    struct io_uring_sqe *sqe = &anneau.sqes[position];
+    memset(sqe, 0, sizeof(*sqe));
+    anneau.sq_tableau[position] = position;
+    anneau.queue_locale++;
+    anneau.a_soumettre++;
+    return sqe;
+}
+
+// Fonction pour construire l'étiquette d'une opération : type, session et détail (case du lot ou moitié du tampon)
+uint64_t etiqueter(int operation, int index, int detail) {
+    return ((uint64_t)operation << 56) | ((uint64_t)index << 24) | (uint64_t)detail;
+}
 
-    if (sendto(sockfd, &ack_packet, sizeof(ack_packet), 0, (struct sockaddr *)addr_client, longueur_client) < 0) {
-        erreur("Erreur lors de l'envoi de l'ACK pour WRQ");
+// Fonction pour préparer une opération de l'anneau sur un descripteur fixe
+struct io_uring_sqe *preparer_operation(int opcode, int fixe, void *adresse, unsigned longueur, off_t position, uint64_t etiquette) {
+    struct io_uring_sqe *sqe = obtenir_sqe();
+    sqe->opcode = opcode;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = fixe;
+    sqe->addr = (uint64_t)(uintptr_t)adresse;
+    sqe->len = longueur;
+    sqe->off = position;
+    sqe->user_data = etiquette;
+    return sqe;
+}
+
+// Fonction pour vérifier que le noyau annule par descripteur fixe (IORING_ASYNC_CANCEL_FD, noyau 6.0), moyen utilisé
+// à la fermeture des sessions : une annulation d'essai sur le socket d'écoute, sans opération en attente, doit
+// répondre -ENOENT et non -EINVAL. Renvoie -1 et ferme l'anneau sinon
+int sonder_annulation() {
+    struct io_uring_sqe *sqe = preparer_operation(IORING_OP_ASYNC_CANCEL, FICHIER_ECOUTE, NULL, 0, 0, 0);
+    sqe->flags = 0;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_FD_FIXED | IORING_ASYNC_CANCEL_ALL;
+    do {
+        soumettre_anneau(1);
+    } while (*anneau.cq_tete == __atomic_load_n(anneau.cq_queue, __ATOMIC_ACQUIRE));
+    int resultat = anneau.cqes[*anneau.cq_tete & *anneau.cq_masque].res;
+    __atomic_store_n(anneau.cq_tete, *anneau.cq_tete + 1, __ATOMIC_RELEASE);
+    if (resultat == -EINVAL) {
+        close(anneau.fd);
+        errno = EINVAL;
+        return -1;
     }
+    return 0;
+}
 
-    while (1) {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
-
-        struct timeval timeout;
-        timeout.tv_sec = TIMEOUT_SEC;
-        timeout.tv_usec = 0;
-
-        int ready = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
-        if (ready < 0) {
-            erreur("Erreur lors de l'appel à select()");
-        } else if (ready == 0) {
-            printf("Timeout lors de l'attente du paquet de données du client.\n");
+// Fonctions donnant les emplacements des descripteurs fixes d'une session
+int fixe_socket(int index) {
+    return 1 + 2 * index;
+}
+
+int fixe_fichier(int index) {
+    return 2 + 2 * index;
+}
+
+// Fonction pour placer un descripteur dans la table des descripteurs fixes (-1 pour libérer l'emplacement)
+void enregistrer_descripteur(int fixe, int fd) {
+    struct io_uring_files_update maj;
+    memset(&maj, 0, sizeof(maj));
+    maj.offset = fixe;
+    maj.fds = (uint64_t)(uintptr_t)&fd;
+    if (syscall(__NR_io_uring_register, anneau.fd, IORING_REGISTER_FILES_UPDATE, &maj, 1) < 0) {
+        erreur("Erreur lors de l'enregistrement d'un descripteur fixe");
+    }
+}
+
+// Fonction pour enregistrer le tampon d'une session (NULL pour le libérer), renvoie 1 si le tampon est enregistré
+int enregistrer_tampon(int index, void *tampon, size_t taille) {
+    if (!tampons_enregistrables) {
+        return 0;
+    }
+    struct iovec iov = { tampon, taille };
+    struct io_uring_rsrc_update2 maj;
+    memset(&maj, 0, sizeof(maj));
+    maj.offset = index;
+    maj.data = (uint64_t)(uintptr_t)&iov;
+    maj.nr = 1;
+    // Peut échouer si la mémoire verrouillable (RLIMIT_MEMLOCK) est épuisée : la session utilise alors des lectures simples
+    return syscall(__NR_io_uring_register, anneau.fd, IORING_REGISTER_BUFFERS_UPDATE, &maj, sizeof(maj)) == 1;
+}
+
+// Fonction pour retirer une session de la roue des timers
+void desarmer_timer(struct session *s) {
+    if (s->emplacement_timer < 0) {
+        return;
+    }
+    if (s->precedent_timer != NULL) {
+        s->precedent_timer->suivant_timer = s->suivant_timer;
+    } else {
+        roue_timers[s->emplacement_timer] = s->suivant_timer;
+    }
+    if (s->suivant_timer != NULL) {
+        s->suivant_timer->precedent_timer = s->precedent_timer;
+    }
+    s->suivant_timer = NULL;
+    s->precedent_timer = NULL;
+    s->emplacement_timer = -1;
+    s->rtt.echeance = 0;
+    timers_armes--;
+}
+
+// Fonction pour (ré)armer le timer de retransmission d'une session : l'estimateur fixe l'échéance, comme pour les
+// sessions des threads, et la roue remplace le délai de réception du socket (appliquer_rto) des appels bloquants
+void armer_timer(struct session *s) {
+    desarmer_timer(s);
+    armer_rtt(&s->rtt);
+    s->emplacement_timer = (s->rtt.echeance / RESOLUTION_ROUE_US) % TAILLE_ROUE;
+    s->precedent_timer = NULL;
+    s->suivant_timer = roue_timers[s->emplacement_timer];
+    if (s->suivant_timer != NULL) {
+        s->suivant_timer->precedent_timer = s;
+    }
+    roue_timers[s->emplacement_timer] = s;
+    timers_armes++;
+}
+
+// Fonction pour calculer le seau de la table des requêtes associé à un client, un opcode et un fichier
+unsigned int seau_requete(const struct sockaddr_in *addr_client, int opcode, const char *nom_fichier) {
+    unsigned int hache = 5381;
+    while (*nom_fichier) {
+        hache = hache * 33 + (unsigned char)*nom_fichier++;
+    }
+    hache = hache * 33 + addr_client->sin_addr.s_addr;
+    hache = hache * 33 + addr_client->sin_port;
+    hache = hache * 33 + opcode;
+    return hache % SEAUX_SESSIONS;
+}
+
+// Fonction pour ajouter une session ouverte aux tables de hachage
+void indexer_session(struct session *s) {
+    unsigned int seau = seau_requete(&s->addr_client, s->type, s->nom_fichier);
+    s->suivant_requete = table_requetes[seau];
+    table_requetes[seau] = s;
+    seau = ntohs(s->tid) % SEAUX_SESSIONS;
+    s->suivant_tid = table_tid[seau];
+    table_tid[seau] = s;
+}
+
+// Fonction pour retirer une session des tables de hachage
+void desindexer_session(struct session *s) {
+    struct session **courant = &table_requetes[seau_requete(&s->addr_client, s->type, s->nom_fichier)];
+    while (*courant != s) {
+        courant = &(*courant)->suivant_requete;
+    }
+    *courant = s->suivant_requete;
+    courant = &table_tid[ntohs(s->tid) % SEAUX_SESSIONS];
+    while (*courant != s) {
+        courant = &(*courant)->suivant_tid;
+    }
+    *courant = s->suivant_tid;
+}
+
+// Fonction pour chercher la session ouverte pour une requête, NULL si aucune
+struct session *chercher_session_requete(const struct sockaddr_in *addr_client, int opcode, const char *nom_fichier) {
+    struct session *s = table_requetes[seau_requete(addr_client, opcode, nom_fichier)];
+    while (s != NULL && (s->type != opcode || !meme_client(&s->addr_client, addr_client) || strcmp(s->nom_fichier, nom_fichier) != 0)) {
+        s = s->suivant_requete;
+    }
+    return s;
+}
+
+// Fonction pour réserver une requête dans la table partagée, renvoie 0 si un autre réacteur la traite déjà
+int reserver_requete(const struct sockaddr_in *addr_client, int opcode, const char *nom_fichier) {
+    unsigned int seau = seau_requete(addr_client, opcode, nom_fichier);
+    pthread_mutex_lock(&mutex_requetes);
+    struct requete_partagee *r = requetes_partagees[seau];
+    while (r != NULL && (r->opcode != opcode || !meme_client(&r->addr_client, addr_client) || strcmp(r->nom_fichier, nom_fichier) != 0)) {
+        r = r->suivant;
+    }
+    int reservee = r == NULL;
+    if (reservee) {
+        r = malloc(sizeof(*r));
+        if (r == NULL) {
+            erreur("Erreur lors de l'allocation d'une requête partagée");
+        }
+        r->addr_client = *addr_client;
+        r->opcode = opcode;
+        snprintf(r->nom_fichier, sizeof(r->nom_fichier), "%s", nom_fichier);
+        r->suivant = requetes_partagees[seau];
+        requetes_partagees[seau] = r;
+    }
+    pthread_mutex_unlock(&mutex_requetes);
+    return reservee;
+}
+
+// Fonction pour retirer une requête de la table partagée, à la fermeture de sa session
+void liberer_requete(const struct sockaddr_in *addr_client, int opcode, const char *nom_fichier) {
+    pthread_mutex_lock(&mutex_requetes);
+    struct requete_partagee **courant = &requetes_partagees[seau_requete(addr_client, opcode, nom_fichier)];
+    while (*courant != NULL && ((*courant)->opcode != opcode || !meme_client(&(*courant)->addr_client, addr_client) ||
+                                strcmp((*courant)->nom_fichier, nom_fichier) != 0)) {
+        courant = &(*courant)->suivant;
+    }
+    if (*courant != NULL) {
+        struct requete_partagee *r = *courant;
+        *courant = r->suivant;
+        free(r);
+    }
+    pthread_mutex_unlock(&mutex_requetes);
+}
+
+// Fonction pour chercher la session d'un TID (port local, ordre réseau), NULL si aucune
+struct session *chercher_session_tid(unsigned short tid) {
+    struct session *s = table_tid[ntohs(tid) % SEAUX_SESSIONS];
+    while (s != NULL && s->tid != tid) {
+        s = s->suivant_tid;
+    }
+    return s;
+}
+
+// Fonction pour libérer toutes les ressources d'une session
+void liberer_session(struct session *s) {
+    if (mode_anneau) {
+        int index = s - sessions;
+        enregistrer_descripteur(fixe_socket(index), -1);
+        enregistrer_descripteur(fixe_fichier(index), -1);
+        if (s->tampon_enregistre) {
+            enregistrer_tampon(index, NULL, 0);
+        }
+        free(s->envois);
+        free(s->reception);
+        s->envois = NULL;
+        s->reception = NULL;
+    }
+    close(s->sockfd); // Retire aussi le socket de l'ensemble epoll
+    if (s->fichier != NULL) {
+        fclose(s->fichier);
+    }
+    if (s->chemin_temporaire[0] != '\0') {
+        // WRQ interrompue : le fichier publié, s'il existait, reste intact
+        unlink(s->chemin_temporaire);
+    }
+    free(s->tampon);
+    s->tampon = NULL;
+    s->fichier = NULL;
+    s->etat = SESSION_LIBRE;
+    sessions_actives--;
+    compter(&compteurs()->sessions_fermees, 1);
+}
+
+// Fonction pour terminer une session
+void fermer_session(struct session *s) {
+    if (s->emplacement_timer >= 0) {
+        desarmer_timer(s);
+    }
+    // Une nouvelle requête identique ouvrira une nouvelle session
+    desindexer_session(s);
+    if (partage_requetes) {
+        liberer_requete(&s->addr_client, s->type, s->nom_fichier);
+    }
+    if (mode_anneau) {
+        // Les opérations encore en vol utilisent les tampons de la session : libération à leur dernière complétion
+        int index = s - sessions;
+        s->etat = SESSION_FERMETURE;
+        struct io_uring_sqe *sqe = preparer_operation(IORING_OP_ASYNC_CANCEL, fixe_socket(index), NULL, 0, 0, etiqueter(OPERATION_ANNULATION, index, 0));
+        sqe->flags = 0;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_FD_FIXED | IORING_ASYNC_CANCEL_ALL;
+        s->operations_en_cours++;
+        return;
+    }
+    liberer_session(s);
+}
+
+// Fonction pour lancer la lecture des tranches du fichier dont ont besoin la fenêtre courante et la suivante
+void charger_tranches(struct session *s) {
+    int index = s - sessions;
+    long taille_tranche = (long)s->options.windowsize * s->options.blksize;
+    long premiere = s->envoi.dernier_ack / s->options.windowsize;
+    for (long tranche = premiere; tranche <= premiere + 1; tranche++) {
+        int moitie = tranche % 2;
+        if (tranche * s->options.windowsize + 1 > s->envoi.dernier_bloc) {
+            break; // Tranche au-delà du dernier bloc
+        }
+        if (s->tranche[moitie] == tranche || s->tranche_lue[moitie] >= 0) {
+            // Tranche déjà chargée, ou moitié occupée par une lecture dont on attend la fin
             continue;
-        } else {
-            if (FD_ISSET(sockfd, &readfds)) {
-                int bytes_recus = recvfrom(sockfd, buffer, TAILLE_PAQUET, 0, (struct sockaddr *)addr_client, &longueur_client);
-                if (bytes_recus < 0) {
-                    erreur("Erreur de réception des données");
-                }
+        }
+        s->tranche_lue[moitie] = tranche;
+        struct io_uring_sqe *sqe = preparer_operation(s->tampon_enregistre ? IORING_OP_READ_FIXED : IORING_OP_READ, fixe_fichier(index),
+                                                      s->tampon + moitie * s->taille_moitie, taille_tranche, tranche * taille_tranche,
+                                                      etiqueter(OPERATION_LECTURE, index, moitie));
+        if (s->tampon_enregistre) {
+            sqe->buf_index = index;
+        }
+        s->operations_en_cours++;
+    }
+}
 
-                unsigned char opcode = buffer[1];
-                if (opcode == OPCODE_DATA) {
-                    // Réception du paquet de données
-                    numero_bloc++;
-                    fwrite(buffer + 4, 1, bytes_recus - 4, fichier); // Écriture des données dans le fichier
-
-                    // Envoi de l'ACK
-                    ack_packet.block_num = htons(numero_bloc);
-
-                    if (sendto(sockfd, &ack_packet, sizeof(ack_packet), 0, (struct sockaddr *)addr_client, longueur_client) < 0) {
-                        erreur("Erreur lors de l'envoi de l'ACK pour DATA");
-                    }
-
-                    if (bytes_recus < TAILLE_PAQUET) {
-                        // Dernier paquet de données
-                        break;
-                    }
-                } else if (opcode == OPCODE_ERROR) {
-                    // Erreur reçue du client
-                    fprintf(stderr, "Erreur du client: %s\n", buffer + 4);
-                    fclose(fichier);
-                    remove(nom_fichier); // Supprimer le fichier en cas d'erreur
-                    return -1;
-                }
+// Fonction pour compter les blocs d'une fenêtre préparée, ceux jusqu'au plus haut déjà envoyé étant des retransmissions
+void compter_fenetre(struct session *s, long premier_envoye, long octets) {
+    long nb_retransmis = fenetre_envoyee(&s->envoi, premier_envoye, maintenant_us());
+    if (s->envoi.prochain_bloc > premier_envoye) {
+        compter_envoi(s->envoi.prochain_bloc - premier_envoye, nb_retransmis, octets);
+        journaliser_bloc(s->id, EV_FENETRE, premier_envoye, s->envoi.prochain_bloc - premier_envoye);
+    }
+}
+
+// Fonction pour envoyer par l'anneau les blocs de la fenêtre courante déjà lus, la lecture de la suite étant lancée d'avance
+void envoyer_fenetre_anneau(struct session *s) {
+    int index = s - sessions;
+    int windowsize = s->options.windowsize;
+    charger_tranches(s);
+    int nb_paquets = 0;
+    long premier_envoye = s->envoi.prochain_bloc;
+    long octets_fenetre = 0;
+    while (bloc_a_envoyer(&s->envoi)) {
+        long tranche = (s->envoi.prochain_bloc - 1) / windowsize;
+        int moitie = tranche % 2;
+        if (s->tranche[moitie] != tranche) {
+            // Bloc pas encore lu : la suite de la fenêtre partira à la fin de la lecture
+            break;
+        }
+        int debut = (int)((s->envoi.prochain_bloc - 1) % windowsize) * s->options.blksize;
+        int taille = s->octets_charges[moitie] - debut;
+        taille = taille < 0 ? 0 : (taille > s->options.blksize ? s->options.blksize : taille);
+
+        struct envoi_paquet *e = &s->envois[(s->envoi.prochain_bloc - 1) % (2 * windowsize)];
+        e->entete.opcode = htons(OPCODE_DATA);
+        e->entete.block_num = htons(bloc_sur_fil(s->envoi.prochain_bloc, s->options.rollover));
+        e->iov[0].iov_base = &e->entete;
+        e->iov[0].iov_len = sizeof(e->entete);
+        e->iov[1].iov_base = s->tampon + moitie * s->taille_moitie + debut;
+        e->iov[1].iov_len = taille;
+        memset(&e->message, 0, sizeof(e->message));
+        e->message.msg_name = &s->addr_client;
+        e->message.msg_namelen = sizeof(struct sockaddr_in);
+        e->message.msg_iov = e->iov;
+        e->message.msg_iovlen = 2;
+        preparer_operation(IORING_OP_SENDMSG, fixe_socket(index), &e->message, 1, 0, etiqueter(OPERATION_ENVOI, index, 0));
+        s->operations_en_cours++;
+        nb_paquets++;
+        octets_fenetre += taille;
+        s->envoi.prochain_bloc++;
+    }
+
+    compter_fenetre(s, premier_envoye, octets_fenetre);
+    if (nb_paquets > 0) {
+        // Tous les paquets de la fenêtre partent au prochain io_uring_enter
+        s->appels_envoi++;
+        s->paquets_envoyes += nb_paquets;
+    }
+    if (nb_paquets > 0 || s->emplacement_timer < 0) {
+        armer_timer(s);
+    }
+}
+
+// Fonction pour envoyer tous les blocs de la fenêtre courante d'une session RRQ
+void envoyer_fenetre(struct session *s) {
+    if (mode_anneau) {
+        envoyer_fenetre_anneau(s);
+        return;
+    }
+    size_t taille_case = sizeof(struct tftp_data_packet) + s->options.blksize;
+    int nb_paquets = 0;
+    long premier_envoye = s->envoi.prochain_bloc;
+    long octets_fenetre = 0;
+    while (bloc_a_envoyer(&s->envoi)) {
+        if (s->bloc_fichier != s->envoi.prochain_bloc) {
+            // Retour en arrière après une perte : repositionnement dans le fichier
+            fseeko(s->fichier, (off_t)(s->envoi.prochain_bloc - 1) * s->options.blksize, SEEK_SET);
+            s->bloc_fichier = s->envoi.prochain_bloc;
+        }
+        struct tftp_data_packet *data_packet = (struct tftp_data_packet *)(s->tampon + nb_paquets * taille_case);
+        data_packet->opcode = htons(OPCODE_DATA);
+        data_packet->block_num = htons(bloc_sur_fil(s->envoi.prochain_bloc, s->options.rollover));
+
+        int bytes_lus = fread(data_packet->data, 1, s->options.blksize, s->fichier);
+        s->bloc_fichier++;
+        if (bytes_lus < s->options.blksize) {
+            // Dernier paquet de données
+            s->envoi.dernier_bloc = s->envoi.prochain_bloc;
+        }
+        iov_envoi[nb_paquets].iov_base = data_packet;
+        iov_envoi[nb_paquets].iov_len = bytes_lus + 4;
+        memset(&messages_envoi[nb_paquets].msg_hdr, 0, sizeof(struct msghdr));
+        messages_envoi[nb_paquets].msg_hdr.msg_name = &s->addr_client;
+        messages_envoi[nb_paquets].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        messages_envoi[nb_paquets].msg_hdr.msg_iov = &iov_envoi[nb_paquets];
+        messages_envoi[nb_paquets].msg_hdr.msg_iovlen = 1;
+        nb_paquets++;
+        octets_fenetre += bytes_lus;
+        s->envoi.prochain_bloc++;
+    }
+
+    compter_fenetre(s, premier_envoye, octets_fenetre);
+
+    // Toute la fenêtre part en un seul appel sendmmsg ; si le tampon d'émission est plein, le reste sera renvoyé au timeout
+    int envoyes = 0;
+    while (envoyes < nb_paquets) {
+        int n = sendmmsg(s->sockfd, messages_envoi + envoyes, nb_paquets - envoyes, 0);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                journaliser(NIVEAU_ERREUR, s->id, EV_ERREUR, s->envoi.prochain_bloc, "Erreur lors de l'envoi de la fenêtre: %s", strerror(errno));
             }
+            break;
         }
+        envoyes += n;
+        s->appels_envoi++;
+    }
+    s->paquets_envoyes += envoyes;
+    armer_timer(s);
+}
+
+// Fonction pour envoyer la fenêtre suivante d'une session RRQ une fois tous les ACK d'un lot pris en compte
+void relancer_fenetre(struct session *s) {
+    // ACK partiel : le client a détecté un trou, on reprend après le bloc acquitté
+    long a_renvoyer = conclure_acks(&s->envoi, &s->rtt);
+    if (a_renvoyer > 0) {
+        journaliser_bloc(s->id, EV_RETRANSMISSION, s->envoi.dernier_ack + 1, a_renvoyer);
     }
+    envoyer_fenetre(s);
+}
 
-    fclose(fichier);
-    printf("Fin de la réception du fichier du fichier '%s'\n", nom_fichier);
-    return 0;
+// Fonction pour renvoyer le dernier acquittement d'une session WRQ (OACK avant le premier bloc)
+void renvoyer_acquittement(struct session *s) {
+    if (s->recus.numero_bloc == 0 && s->taille_oack > 0) {
+        sendto(s->sockfd, s->oack, s->taille_oack, 0, (struct sockaddr *)&s->addr_client, sizeof(struct sockaddr_in));
+    } else {
+        envoyer_ack(s->sockfd, &s->addr_client, bloc_sur_fil(s->recus.numero_bloc, s->options.rollover));
+    }
 }
 
-// Fonction pour recevoir une demande de lecture (RRQ) du client
-int recevoir_rrq(int sockfd, struct sockaddr_in *addr_client, const char *nom_fichier, const char *mode) {
-    printf("Requête de lecture (RRQ) reçue pour le fichier '%s'\n", nom_fichier);
-    char buffer[TAILLE_PAQUET];
-    socklen_t longueur_client = sizeof(struct sockaddr_in);
-    FILE *fichier = fopen(nom_fichier, "rb"); // Ouverture en mode lecture binaire
-    int numero_bloc = 1;
+// Fonction pour soumettre la réception du prochain datagramme d'une session
+void armer_reception(struct session *s) {
+    int index = s - sessions;
+    memset(&s->message_reception, 0, sizeof(s->message_reception));
+    s->message_reception.msg_name = &s->source_reception;
+    s->message_reception.msg_namelen = sizeof(struct sockaddr_in);
+    s->message_reception.msg_iov = &s->iov_reception;
+    s->message_reception.msg_iovlen = 1;
+    preparer_operation(IORING_OP_RECVMSG, fixe_socket(index), &s->message_reception, 1, 0, etiqueter(OPERATION_RECEPTION, index, 0));
+    s->operations_en_cours++;
+}
+
+// Fonction pour préparer une session pour l'anneau : descripteurs fixes, tampon enregistré et première réception
+void preparer_session_anneau(struct session *s, int index) {
+    enregistrer_descripteur(fixe_socket(index), s->sockfd);
+    enregistrer_descripteur(fixe_fichier(index), fileno(s->fichier));
+    if (s->type == OPCODE_RRQ) {
+        // Une moitié pour la tranche de la fenêtre courante, l'autre pour la tranche suivante lue d'avance
+        s->taille_moitie = (size_t)s->options.windowsize * s->options.blksize;
+        s->tranche[0] = s->tranche[1] = -1;
+        s->tranche_lue[0] = s->tranche_lue[1] = -1;
+        s->envois = malloc(2 * s->options.windowsize * sizeof(struct envoi_paquet));
+        if (s->envois == NULL) {
+            erreur("Erreur lors de l'allocation des messages d'envoi");
+        }
+    } else {
+        // Moitiés d'un nombre entier de blocs : un bloc reçu n'est jamais coupé entre deux écritures
+        s->taille_moitie = (TAILLE_MOITIE_ECRITURE / s->options.blksize) * s->options.blksize;
+    }
+    if (posix_memalign((void **)&s->tampon, ALIGNEMENT_TAMPON, 2 * s->taille_moitie) != 0) {
+        erreur("Erreur lors de l'allocation du tampon de session");
+    }
+    s->tampon_enregistre = enregistrer_tampon(index, s->tampon, 2 * s->taille_moitie);
+
+    // Un octet de plus que le plus grand paquet attendu pour reconnaître les datagrammes trop longs
+    s->iov_reception.iov_len = s->options.blksize + 5 > TAILLE_PAQUET ? s->options.blksize + 5 : TAILLE_PAQUET;
+    s->reception = malloc(s->iov_reception.iov_len);
+    if (s->reception == NULL) {
+        erreur("Erreur lors de l'allocation du tampon de réception");
+    }
+    s->iov_reception.iov_base = s->reception;
+    armer_reception(s);
+}
+
+// Fonction pour créer une session à partir d'une requête RRQ/WRQ reçue sur le port d'écoute, renvoie -1 si elle
+// n'a pas pu être ouverte (une erreur a alors été envoyée au client si possible)
+int ouvrir_session(int epollfd, int opcode, struct sockaddr_in *addr_client, const char *nom_fichier, const struct options_tftp *options) {
+    // Recherche d'une entrée libre dans la table des sessions
+    int index = -1;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        int candidat = (prochaine_session + i) % MAX_CLIENTS;
+        if (sessions[candidat].etat == SESSION_LIBRE) {
+            index = candidat;
+            break;
+        }
+    }
+
+    // Socket éphémère propre à la session (TID du serveur), lié tout de suite pour connaître son port
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0) {
+        perror("Erreur lors de la création du socket de session");
+        return -1;
+    }
+    struct sockaddr_in addr_session;
+    socklen_t taille_addr = sizeof(addr_session);
+    memset(&addr_session, 0, sizeof(addr_session));
+    addr_session.sin_family = AF_INET;
+    if (bind(sockfd, (struct sockaddr *)&addr_session, sizeof(addr_session)) < 0 ||
+        getsockname(sockfd, (struct sockaddr *)&addr_session, &taille_addr) < 0) {
+        perror("Erreur lors du liage du socket de session");
+        close(sockfd);
+        return -1;
+    }
+    if (index < 0) {
+        envoyer_erreur(sockfd, addr_client, 0, "Serveur surchargé, réessayez plus tard.");
+        close(sockfd);
+        return -1;
+    }
+    prochaine_session = (index + 1) % MAX_CLIENTS;
+
+    // WRQ : écriture dans un fichier temporaire du même répertoire, renommé à la réception du dernier bloc pour
+    // que les lectures de ce réacteur voient toujours soit l'ancienne soit la nouvelle version complète
+    char chemin_temporaire[TAILLE_PAQUET + 16] = "";
+    FILE *fichier;
+    if (opcode == OPCODE_RRQ) {
+        fichier = fopen(nom_fichier, "rb");
+    } else {
+        snprintf(chemin_temporaire, sizeof(chemin_temporaire), "%s.XXXXXX", nom_fichier);
+        int fd_temporaire = mkstemp(chemin_temporaire);
+        fichier = fd_temporaire < 0 ? NULL : fdopen(fd_temporaire, "w+b");
+        if (fd_temporaire >= 0 && fichier == NULL) {
+            close(fd_temporaire);
+            unlink(chemin_temporaire);
+        } else if (fichier != NULL) {
+            fchmod(fd_temporaire, 0644);
+        }
+    }
     if (fichier == NULL) {
-        // Fichier introuvable, envoi du paquet d'erreur
-        buffer[0] = 0;
-        buffer[1] = OPCODE_ERROR;
-        buffer[2] = 0;
-        buffer[3] = 1; // Code d'erreur pour fichier non trouvé
-        strcpy(buffer + 4, "Fichier non trouvé.");
-        sendto(sockfd, buffer, strlen("Fichier non trouvé.") + 5, 0, (struct sockaddr *)addr_client, longueur_client);
+        if (opcode == OPCODE_RRQ) {
+            envoyer_erreur(sockfd, addr_client, 1, "Fichier non trouvé.");
+        } else {
+            envoyer_erreur(sockfd, addr_client, 2, "Impossible de créer le fichier.");
+        }
+        close(sockfd);
         return -1;
     }
 
-    // Envoi du premier paquet de données
-    while (1) {
-        struct tftp_data_packet data_packet;
-        data_packet.opcode = htons(OPCODE_DATA);
-        data_packet.block_num = htons(numero_bloc);
+    struct stat infos;
+    fstat(fileno(fichier), &infos);
+    if (opcode == OPCODE_WRQ && options->tsize > 0 && fallocate(fileno(fichier), FALLOC_FL_KEEP_SIZE, 0, options->tsize) < 0 && errno == ENOSPC) {
+        // Réservation de l'espace annoncé par tsize impossible
+        envoyer_erreur(sockfd, addr_client, 3, "Espace disque insuffisant.");
+        fclose(fichier);
+        unlink(chemin_temporaire);
+        close(sockfd);
+        return -1;
+    }
 
-        int bytes_lus = fread(data_packet.data, 1, TAILLE_PAQUET - 4, fichier);
-        if (bytes_lus < TAILLE_PAQUET - 4) {
-            // Dernier paquet de données
-            sendto(sockfd, &data_packet, bytes_lus + 4, 0, (struct sockaddr *)addr_client, longueur_client);
-            break;
+    struct session *s = &sessions[index];
+    memset(s, 0, sizeof(*s));
+    s->id = __atomic_add_fetch(&prochaine_session_journal, 1, __ATOMIC_RELAXED);
+    s->sockfd = sockfd;
+    s->tid = addr_session.sin_port;
+    s->type = opcode;
+    s->addr_client = *addr_client;
+    s->fichier = fichier;
+    s->options = *options;
+    if (opcode == OPCODE_RRQ) {
+        s->options.tsize = infos.st_size; // Taille renvoyée dans l'OACK si le client a demandé tsize
+    }
+    s->emplacement_timer = -1;
+    initialiser_rtt(&s->rtt, options->timeout);
+    initialiser_envoi(&s->envoi, options);
+    initialiser_reception(&s->recus, options);
+    snprintf(s->nom_fichier, sizeof(s->nom_fichier), "%s", nom_fichier);
+    snprintf(s->chemin_temporaire, sizeof(s->chemin_temporaire), "%s", chemin_temporaire);
+    s->taille_oack = construire_oack(s->oack, &s->options);
+    dimensionner_tampons(sockfd, options);
+    indexer_session(s);
+
+    if (mode_anneau) {
+        preparer_session_anneau(s, index);
+    } else {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = index;
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+            erreur("Erreur lors de l'ajout du socket de session à epoll");
+        }
+    }
+    sessions_actives++;
+    compter(&compteurs()->sessions_ouvertes, 1);
+
+    if (opcode == OPCODE_RRQ) {
+        journaliser(NIVEAU_INFO, s->id, EV_REQUETE, 0, "Requête de lecture (RRQ) reçue pour le fichier '%s'", nom_fichier);
+        if (mode_anneau) {
+            // Les lectures étant asynchrones, le dernier bloc est déduit de la taille du fichier
+            s->envoi.dernier_bloc = infos.st_size / options->blksize + 1;
+        } else {
+            // Une case par bloc de la fenêtre, dimensionnée pour la taille de bloc négociée
+            s->tampon = malloc((size_t)options->windowsize * (sizeof(struct tftp_data_packet) + options->blksize));
+            if (s->tampon == NULL) {
+                erreur("Erreur lors de l'allocation du paquet de données");
+            }
+        }
+        s->bloc_fichier = 1;
+        if (s->taille_oack > 0) {
+            // Négociation des options avant le premier paquet de données
+            s->etat = SESSION_ATTENTE_ACK_OACK;
+            sendto(sockfd, s->oack, s->taille_oack, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in));
+            s->instant_mesure = maintenant_us();
+            armer_timer(s);
+            if (mode_anneau) {
+                // La première fenêtre est lue pendant la négociation
+                charger_tranches(s);
+            }
         } else {
-            sendto(sockfd, &data_packet, TAILLE_PAQUET, 0, (struct sockaddr *)addr_client, longueur_client);
+            s->etat = SESSION_ENVOI;
+            envoyer_fenetre(s);
+        }
+    } else {
+        journaliser(NIVEAU_INFO, s->id, EV_REQUETE, 0, "Requête d'écriture (WRQ) reçue pour le fichier '%s'", nom_fichier);
+        s->etat = SESSION_RECEPTION;
+        renvoyer_acquittement(s);
+        s->instant_mesure = maintenant_us();
+        armer_timer(s);
+    }
+    return 0;
+}
+
+// Fonction pour traiter un paquet reçu par une session RRQ, renvoie 1 si la fenêtre suivante doit être envoyée
+int traiter_paquet_rrq(struct session *s, const char *buffer, int bytes_recus) {
+    struct paquet_decode paquet;
+    if (decoder_paquet(buffer, bytes_recus, &paquet) < 0) {
+        return 0;
+    }
+    if (paquet.opcode == OPCODE_ERROR) {
+        compter_erreur_recue(paquet.code_erreur);
+        journaliser(NIVEAU_ERREUR, s->id, EV_ERREUR_CLIENT, s->envoi.dernier_ack, "Erreur du client: %s", paquet.message.texte);
+        fermer_session(s);
+        return 0;
+    }
+    if (paquet.opcode != OPCODE_ACK) {
+        return 0;
+    }
+    unsigned short ack_block_num = paquet.bloc;
+
+    if (s->etat == SESSION_ATTENTE_ACK_OACK) {
+        // L'ACK du bloc 0 valide les options, le transfert peut commencer
+        if (ack_block_num == 0) {
+            s->etat = SESSION_ENVOI;
+            progression_rtt(&s->rtt);
+            if (s->instant_mesure != 0) {
+                mesurer_rtt(&s->rtt, maintenant_us() - s->instant_mesure);
+                s->instant_mesure = 0;
+            }
+            return 1;
         }
+        return 0;
+    }
 
-        // Attendre l'ACK du client avec timeout
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
+    long avance = accepter_ack(&s->envoi, ack_block_num, s->envoi.prochain_bloc - 1);
+    if (avance == 0) {
+        return 0;
+    }
+    progression_rtt(&s->rtt);
+    journaliser_bloc(s->id, EV_ACK, s->envoi.dernier_ack, avance);
+    if (s->envoi.dernier_bloc != 0 && s->envoi.dernier_ack == s->envoi.dernier_bloc) {
+        conclure_acks(&s->envoi, &s->rtt);
+        journaliser(NIVEAU_INFO, s->id, EV_FIN, s->envoi.dernier_ack, "Fin de l'envoi du fichier '%s' (%ld paquets en %ld %s, %.1f par lot ; %ld ACK en %ld %s, %.1f par lot ; RTT lissé %ld us, RTO %ld us)",
+                    s->nom_fichier, s->paquets_envoyes, s->appels_envoi, mode_anneau ? "fenêtres io_uring" : "sendmmsg",
+                    s->appels_envoi ? (double)s->paquets_envoyes / s->appels_envoi : 0.0,
+                    s->paquets_recus, s->appels_reception, mode_anneau ? "recvmsg io_uring" : "recvmmsg", s->appels_reception ? (double)s->paquets_recus / s->appels_reception : 0.0,
+                    s->rtt.srtt, s->rtt.rto);
+        fermer_session(s);
+        return 0;
+    }
+    return 1;
+}
 
-        struct timeval timeout;
-        timeout.tv_sec = TIMEOUT_SEC;
-        timeout.tv_usec = 0;
+// Fonction pour abandonner une session WRQ dont une écriture ou une synchronisation a échoué (code errno, 0 pour
+// une écriture incomplète)
+void echec_ecriture(struct session *s, int code) {
+    journaliser(NIVEAU_ERREUR, s->id, EV_ERREUR, s->recus.numero_bloc, "Erreur lors de l'écriture du fichier '%s': %s", s->nom_fichier,
+                code != 0 ? strerror(code) : "écriture incomplète");
+    envoyer_erreur(s->sockfd, &s->addr_client, 3, code == 0 || code == ENOSPC ? "Espace disque insuffisant." : "Erreur lors de l'écriture du fichier.");
+    fermer_session(s);
+}
 
-        int ready = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
-        if (ready < 0) {
-            erreur("Erreur lors de l'appel à select()");
-        } else if (ready == 0) {
-            printf("Timeout lors de l'attente de l'ACK du client.\n");
-            continue;
+// Fonction pour publier le fichier reçu par une session WRQ, acquitter son dernier bloc et la terminer
+void terminer_reception(struct session *s) {
+    // Sans l'anneau, les données sont vidées et synchronisées ici ; avec l'anneau, conclure_ecritures l'a déjà fait.
+    // Le fdatasync bloque le réacteur le temps de l'écriture sur disque
+    if (!mode_anneau && (fflush(s->fichier) != 0 || (mode_durabilite != DURABILITE_AUCUNE && fdatasync(fileno(s->fichier)) < 0))) {
+        echec_ecriture(s, errno);
+        return;
+    }
+    if (rename(s->chemin_temporaire, s->nom_fichier) < 0) {
+        journaliser(NIVEAU_ERREUR, s->id, EV_ERREUR, s->recus.numero_bloc, "Erreur lors de l'enregistrement du fichier '%s': %s", s->nom_fichier, strerror(errno));
+        envoyer_erreur(s->sockfd, &s->addr_client, 3, "Erreur lors de l'enregistrement du fichier.");
+        fermer_session(s);
+        return;
+    }
+    s->chemin_temporaire[0] = '\0';
+    envoyer_ack(s->sockfd, &s->addr_client, bloc_sur_fil(s->recus.numero_bloc, s->options.rollover));
+    journaliser(NIVEAU_INFO, s->id, EV_FIN, s->recus.numero_bloc, "Fin de la réception du fichier '%s' (%ld paquets en %ld %s, %.1f par lot)", s->nom_fichier,
+                s->paquets_recus, s->appels_reception, mode_anneau ? "recvmsg io_uring" : "recvmmsg",
+                s->appels_reception ? (double)s->paquets_recus / s->appels_reception : 0.0);
+    fermer_session(s);
+}
+
+// Fonction pour soumettre à l'anneau la synchronisation des données écrites par une session WRQ
+void synchroniser_anneau(struct session *s) {
+    int index = s - sessions;
+    struct io_uring_sqe *sqe = preparer_operation(IORING_OP_FSYNC, fixe_fichier(index), NULL, 0, 0, etiqueter(OPERATION_SYNCHRONISATION, index, 0));
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    s->operations_en_cours++;
+    s->synchronisation_en_cours = 1;
+    s->depuis_sync = 0;
+}
+
+// Fonction pour terminer une session WRQ de l'anneau une fois toutes ses écritures faites : synchronisation selon
+// la politique de durabilité, puis publication du fichier
+void conclure_ecritures(struct session *s) {
+    if (s->taille_ecriture[0] != 0 || s->taille_ecriture[1] != 0 || s->synchronisation_en_cours) {
+        return;
+    }
+    if (mode_durabilite != DURABILITE_AUCUNE && !s->fin_synchronisee) {
+        s->fin_synchronisee = 1;
+        synchroniser_anneau(s);
+        return;
+    }
+    terminer_reception(s);
+}
+
+// Fonction pour écrire la moitié courante du tampon d'une session WRQ par l'anneau et passer à l'autre moitié
+void ecrire_moitie(struct session *s) {
+    int index = s - sessions;
+    int moitie = s->moitie_courante;
+    struct io_uring_sqe *sqe = preparer_operation(s->tampon_enregistre ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fixe_fichier(index),
+                                                  s->tampon + moitie * s->taille_moitie, s->remplissage, s->position_ecriture,
+                                                  etiqueter(OPERATION_ECRITURE, index, moitie));
+    if (s->tampon_enregistre) {
+        sqe->buf_index = index;
+    }
+    s->operations_en_cours++;
+    s->taille_ecriture[moitie] = s->remplissage;
+    s->position_ecriture += s->remplissage;
+    s->moitie_courante = 1 - moitie;
+    s->remplissage = 0;
+    if (s->taille_ecriture[s->moitie_courante] > 0) {
+        // L'autre moitié n'est pas encore écrite : la réception attend que le disque la libère
+        s->reception_suspendue = 1;
+    }
+}
+
+// Fonction pour traiter un paquet reçu par une session WRQ
+void traiter_paquet_wrq(struct session *s, const char *buffer, int bytes_recus) {
+    struct paquet_decode paquet;
+    if (decoder_paquet(buffer, bytes_recus, &paquet) < 0) {
+        return;
+    }
+    if (paquet.opcode == OPCODE_ERROR) {
+        // Erreur reçue du client
+        compter_erreur_recue(paquet.code_erreur);
+        journaliser(NIVEAU_ERREUR, s->id, EV_ERREUR_CLIENT, s->recus.numero_bloc, "Erreur du client: %s", paquet.message.texte);
+        fermer_session(s); // Le fichier temporaire est supprimé avec la session
+        return;
+    }
+    if (paquet.opcode != OPCODE_DATA || paquet.taille_donnees > s->options.blksize) {
+        return;
+    }
+    int classement = recevoir_bloc(&s->recus, paquet.bloc);
+    if (classement == BLOC_SUIVANT) {
+        // Réception du paquet de données attendu
+        progression_rtt(&s->rtt);
+        compter(&compteurs()->blocs_recus, 1);
+        compter(&compteurs()->octets_recus, paquet.taille_donnees);
+        journaliser_bloc(s->id, EV_BLOC_RECU, s->recus.numero_bloc, paquet.taille_donnees);
+        if (s->instant_mesure != 0) {
+            // Premier bloc de la fenêtre suivante : un aller-retour depuis l'ACK
+            mesurer_rtt(&s->rtt, maintenant_us() - s->instant_mesure);
+            s->instant_mesure = 0;
+        }
+        if (mode_anneau) {
+            // Copie dans la moitié courante, écrite d'un seul appel une fois pleine
+            memcpy(s->tampon + s->moitie_courante * s->taille_moitie + s->remplissage, paquet.donnees, paquet.taille_donnees);
+            s->remplissage += paquet.taille_donnees;
+            if (s->remplissage == s->taille_moitie) {
+                ecrire_moitie(s);
+            }
         } else {
-            if (FD_ISSET(sockfd, &readfds)) {
-                int bytes_recus = recvfrom(sockfd, buffer, TAILLE_PAQUET, 0, (struct sockaddr *)addr_client, &longueur_client);
-                if (bytes_recus < 0) {
-                    erreur("Erreur de réception des données");
+            // Écriture dans le fichier, synchronisée tous les intervalle_sync octets en mode périodique
+            if (fwrite(paquet.donnees, 1, paquet.taille_donnees, s->fichier) != (size_t)paquet.taille_donnees) {
+                echec_ecriture(s, errno);
+                return;
+            }
+            s->depuis_sync += paquet.taille_donnees;
+            if (mode_durabilite == DURABILITE_PERIODIQUE && s->depuis_sync >= intervalle_sync) {
+                if (fflush(s->fichier) != 0 || fdatasync(fileno(s->fichier)) < 0) {
+                    echec_ecriture(s, errno);
+                    return;
                 }
+                s->depuis_sync = 0;
+            }
+        }
 
-                if (buffer[1] == OPCODE_ACK) {
-                    unsigned short ack_block_num = ntohs(*(unsigned short *)(buffer + 2));
-                    if (ack_block_num == numero_bloc) {
-                        break;
-                    }
+        if (paquet.taille_donnees < s->options.blksize) {
+            // Dernier paquet de données
+            if (mode_anneau) {
+                // L'ACK final attend que toutes les données soient écrites
+                desarmer_timer(s);
+                s->fin_reception = 1;
+                if (s->remplissage > 0) {
+                    ecrire_moitie(s);
                 }
+                conclure_ecritures(s);
+                return;
             }
+            terminer_reception(s);
+            return;
         }
-        numero_bloc++;
+        // Acquittement cumulatif à la fin de chaque fenêtre
+        if (fenetre_complete(&s->recus)) {
+            envoyer_ack(s->sockfd, &s->addr_client, bloc_sur_fil(s->recus.numero_bloc, s->options.rollover));
+            s->instant_mesure = maintenant_us();
+        }
+        armer_timer(s);
+    } else if (classement == BLOC_HORS_SEQUENCE) {
+        // Doublon ou bloc hors séquence : acquitter le dernier bloc reçu dans l'ordre
+        journaliser_bloc(s->id, EV_HORS_SEQUENCE, paquet.bloc, s->recus.numero_bloc);
+        envoyer_ack(s->sockfd, &s->addr_client, bloc_sur_fil(s->recus.numero_bloc, s->options.rollover));
+        s->instant_mesure = 0;
     }
+}
 
-    fclose(fichier);
-    printf("Fin de l'envoi du fichier '%s'\n", nom_fichier);
-    return 0;
+// Fonction pour recevoir d'un appel recvmmsg tous les datagrammes en attente sur un socket non bloquant
+int recevoir_lot(int sockfd) {
+    for (int i = 0; i < TAILLE_LOT; i++) {
+        messages_reception[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    int n = recvmmsg(sockfd, messages_reception, TAILLE_LOT, 0, NULL);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        perror("Erreur de réception des données");
+    }
+    return n;
 }
 
-// Fonction principale
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <port>\n", argv[0]);
-        exit(1);
+// Fonction pour vider le socket d'une session et faire avancer sa machine à états
+void traiter_session(struct session *s) {
+    while (s->etat != SESSION_LIBRE) {
+        int nb_recus = recevoir_lot(s->sockfd);
+        if (nb_recus <= 0) {
+            return;
+        }
+        s->appels_reception++;
+        s->paquets_recus += nb_recus;
+
+        // Tous les ACK du lot sont pris en compte avant d'envoyer une seule nouvelle fenêtre
+        int relancer = 0;
+        for (int i = 0; i < nb_recus && s->etat != SESSION_LIBRE; i++) {
+            int bytes_recus = messages_reception[i].msg_len;
+            if (bytes_recus < 4 || !meme_client(&sources_reception[i], &s->addr_client)) {
+                continue;
+            }
+            if (s->type == OPCODE_RRQ) {
+                relancer |= traiter_paquet_rrq(s, tampons_reception[i], bytes_recus);
+            } else {
+                traiter_paquet_wrq(s, tampons_reception[i], bytes_recus);
+            }
+        }
+        if (relancer && s->etat == SESSION_ENVOI) {
+            relancer_fenetre(s);
+        }
+        if (nb_recus < TAILLE_LOT) {
+            // Socket vidé
+            return;
+        }
+    }
+}
+
+// Fonction pour retransmettre ce que le client attend d'une session
+void retransmettre_session(struct session *s) {
+    // Les paquets renvoyés ne servent pas à mesurer le RTT (règle de Karn)
+    s->instant_mesure = 0;
+    if (s->etat == SESSION_ATTENTE_ACK_OACK) {
+        sendto(s->sockfd, s->oack, s->taille_oack, 0, (struct sockaddr *)&s->addr_client, sizeof(struct sockaddr_in));
+        compter(&compteurs()->retransmissions, 1);
+        armer_timer(s);
+    } else if (s->etat == SESSION_ENVOI) {
+        // Retour au bloc qui suit le dernier ACK reçu
+        reprendre_envoi(&s->envoi, s->envoi.dernier_ack);
+        envoyer_fenetre(s);
+    } else {
+        // Renvoi du dernier acquittement pour relancer le client
+        renvoyer_acquittement(s);
+        compter(&compteurs()->retransmissions, 1);
+        s->recus.recus_fenetre = 0;
+        armer_timer(s);
+    }
+}
+
+// Fonction pour gérer l'expiration du timer d'une session : retransmission ou abandon
+void expirer_session(struct session *s) {
+    if (expiration_rtt(&s->rtt)) {
+        journaliser(NIVEAU_ERREUR, s->id, EV_ABANDON, s->type == OPCODE_RRQ ? s->envoi.dernier_ack : s->recus.numero_bloc,
+                    "Pas de réponse du client après %ld ms pour le fichier '%s'. Abandon de la session.", s->rtt.attente / 1000, s->nom_fichier);
+        fermer_session(s);
+        return;
+    }
+    journaliser_bloc(s->id, EV_EXPIRATION, s->type == OPCODE_RRQ ? s->envoi.dernier_ack + 1 : s->recus.numero_bloc, s->rtt.rto);
+    retransmettre_session(s);
+}
+
+// Fonction pour faire tourner la roue des timers jusqu'à l'instant présent
+void traiter_timers() {
+    long maintenant = maintenant_us();
+    long tic_courant = maintenant / RESOLUTION_ROUE_US;
+    if (dernier_tic == 0 || tic_courant - dernier_tic > TAILLE_ROUE) {
+        dernier_tic = tic_courant - TAILLE_ROUE;
+    }
+    for (; dernier_tic <= tic_courant; dernier_tic++) {
+        int emplacement = dernier_tic % TAILLE_ROUE;
+        struct session *s = roue_timers[emplacement];
+        while (s != NULL) {
+            struct session *suivant = s->suivant_timer;
+            // Une entrée peut appartenir à un tour ultérieur de la roue
+            if (s->rtt.echeance <= maintenant) {
+                desarmer_timer(s);
+                expirer_session(s);
+            }
+            s = suivant;
+        }
     }
+    dernier_tic = tic_courant;
+}
 
-    int sockfd;
-    struct sockaddr_in addr_serveur;
+// Fonction pour traiter une requête RRQ/WRQ reçue sur le port d'écoute
+void traiter_requete(int epollfd, const char *requete, int taille, struct sockaddr_in *addr_client) {
+    // Analyse du nom de fichier, du mode et des options de la requête
+    struct paquet_decode paquet;
+    struct options_tftp options;
+    if (decoder_paquet(requete, taille, &paquet) < 0) {
+        journaliser(NIVEAU_ERREUR, 0, EV_REQUETE_INVALIDE, 0, "Requête mal formée");
+        return;
+    }
+    analyser_requete(&paquet, &options);
+    options.multicast_negocie = 0; // Pas de groupe multicast (RFC 2090) sur ce serveur
 
-    // Initialisation du socket
-    initialiser_socket(&sockfd, &addr_serveur, atoi(argv[1]));
+    int opcode = paquet.opcode;
+    const char *nom_fichier = paquet.nom_fichier.texte;
+    if (opcode == OPCODE_WRQ || opcode == OPCODE_RRQ) {
+        struct session *s = chercher_session_requete(addr_client, opcode, nom_fichier);
+        if (s == NULL) {
+            // Requête déjà traitée par un autre réacteur (-a) : sa session renverra la réponse à l'expiration de son timer
+            if (partage_requetes && !reserver_requete(addr_client, opcode, nom_fichier)) {
+                journaliser(NIVEAU_DEBUG, 0, EV_REQUETE, 0, "Requête retransmise pour '%s' ignorée, session ouverte par un autre réacteur", nom_fichier);
+                return;
+            }
+            if (ouvrir_session(epollfd, opcode, addr_client, nom_fichier, &options) < 0 && partage_requetes) {
+                liberer_requete(addr_client, opcode, nom_fichier);
+            }
+        } else if (opcode == OPCODE_RRQ ? s->envoi.dernier_ack == 0 : s->recus.numero_bloc == 0) {
+            // Requête retransmise avant tout acquittement : le client n'a pas reçu la première réponse,
+            // la session existante la renvoie depuis son TID au lieu d'ouvrir une session concurrente
+            retransmettre_session(s);
+        }
+    } else {
+        journaliser(NIVEAU_ERREUR, 0, EV_REQUETE_INVALIDE, 0, "Requête inconnue");
+    }
+}
+
+// Fonction pour soumettre la réception d'une requête dans une case du lot de réception du port d'écoute
+void armer_requete(int case_lot) {
+    messages_reception[case_lot].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    preparer_operation(IORING_OP_RECVMSG, FICHIER_ECOUTE, &messages_reception[case_lot].msg_hdr, 1, 0, etiqueter(OPERATION_REQUETE, 0, case_lot));
+}
+
+// Fonction pour soumettre le prochain tic de la roue des timers
+void armer_tic() {
+    tic_anneau.tv_sec = 0;
+    tic_anneau.tv_nsec = RESOLUTION_ROUE_US * 1000L;
+    struct io_uring_sqe *sqe = obtenir_sqe();
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&tic_anneau;
+    sqe->len = 1;
+    sqe->user_data = etiqueter(OPERATION_TIC, 0, 0);
+    tic_arme = 1;
+}
 
-    printf("Serveur TFTP démarré sur le port %s...\n", argv[1]);
+// Fonction pour traiter la complétion d'une opération de l'anneau
+void traiter_completion(uint64_t etiquette, int resultat) {
+    int operation = etiquette >> 56;
+    int index = (etiquette >> 24) & 0xFFFFFFFF;
+    int detail = etiquette & 0xFFFFFF;
+
+    if (operation == OPERATION_TIC) {
+        tic_arme = 0;
+        return;
+    }
+    if (operation == OPERATION_REQUETE) {
+        if (resultat >= 0) {
+            traiter_requete(-1, tampons_reception[detail], resultat, &sources_reception[detail]);
+        } else if (resultat != -EAGAIN) {
+            // Le socket d'écoute est non bloquant (partagé avec -r) : EAGAIN signale seulement une file vide
+            fprintf(stderr, "Erreur de réception des données: %s\n", strerror(-resultat));
+        }
+        armer_requete(detail);
+        return;
+    }
+
+    struct session *s = &sessions[index];
+    s->operations_en_cours--;
+    if (s->etat == SESSION_FERMETURE) {
+        if (operation == OPERATION_ANNULATION && resultat == -EINVAL) {
+            // Annulation refusée : la fermeture du socket termine la réception en attente
+            shutdown(s->sockfd, SHUT_RDWR);
+        }
+        // Session terminée : ses ressources sont libérées à la dernière complétion
+        if (s->operations_en_cours == 0) {
+            liberer_session(s);
+        }
+        return;
+    }
+
+    if (operation == OPERATION_RECEPTION) {
+        if (resultat >= 4 && meme_client(&s->source_reception, &s->addr_client)) {
+            s->appels_reception++;
+            s->paquets_recus++;
+            if (s->type == OPCODE_RRQ) {
+                // Tous les ACK de la série de complétions sont pris en compte avant d'envoyer une seule nouvelle fenêtre
+                if (traiter_paquet_rrq(s, s->reception, resultat) && !s->relance) {
+                    s->relance = 1;
+                    sessions_a_relancer[nb_a_relancer++] = index;
+                }
+            } else {
+                traiter_paquet_wrq(s, s->reception, resultat);
+            }
+        }
+        if (s->etat != SESSION_FERMETURE && !s->fin_reception && !s->reception_suspendue) {
+            armer_reception(s);
+        }
+    } else if (operation == OPERATION_LECTURE) {
+        if (resultat < 0) {
+            journaliser(NIVEAU_ERREUR, s->id, EV_ERREUR, s->envoi.prochain_bloc, "Erreur de lecture du fichier '%s': %s", s->nom_fichier, strerror(-resultat));
+            envoyer_erreur(s->sockfd, &s->addr_client, 0, "Erreur de lecture du fichier.");
+            fermer_session(s);
+            return;
+        }
+        s->tranche[detail] = s->tranche_lue[detail];
+        s->tranche_lue[detail] = -1;
+        s->octets_charges[detail] = resultat;
+        // Une session à relancer attend la conclusion de ses ACK avant d'envoyer
+        if (s->etat == SESSION_ENVOI && !s->relance) {
+            envoyer_fenetre_anneau(s);
+        } else {
+            charger_tranches(s);
+        }
+    } else if (operation == OPERATION_ECRITURE) {
+        if (resultat < 0 || (size_t)resultat != s->taille_ecriture[detail]) {
+            echec_ecriture(s, resultat < 0 ? -resultat : 0);
+            return;
+        }
+        s->taille_ecriture[detail] = 0;
+        s->depuis_sync += resultat;
+        if (s->fin_reception) {
+            conclure_ecritures(s);
+            return;
+        }
+        if (mode_durabilite == DURABILITE_PERIODIQUE && s->depuis_sync >= intervalle_sync && !s->synchronisation_en_cours) {
+            synchroniser_anneau(s);
+        }
+        if (s->reception_suspendue && s->taille_ecriture[s->moitie_courante] == 0) {
+            // La moitié courante est libre : reprise de la réception
+            s->reception_suspendue = 0;
+            armer_reception(s);
+        }
+    } else if (operation == OPERATION_SYNCHRONISATION) {
+        s->synchronisation_en_cours = 0;
+        if (resultat < 0) {
+            echec_ecriture(s, -resultat);
+            return;
+        }
+        if (s->fin_reception) {
+            conclure_ecritures(s);
+        }
+    }
+    // Les envois et l'annulation n'ont rien à traiter : un paquet perdu est renvoyé à l'expiration du timer
+}
 
-    fd_set readfds;
-    int max_sd = sockfd;
+// Fonction pour traiter toutes les complétions disponibles dans la file de complétion
+void traiter_completions() {
+    unsigned tete = *anneau.cq_tete;
+    while (tete != __atomic_load_n(anneau.cq_queue, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe cqe = anneau.cqes[tete & *anneau.cq_masque];
+        tete++;
+        // L'entrée est rendue au noyau avant son traitement, qui peut lui-même soumettre des opérations
+        __atomic_store_n(anneau.cq_tete, tete, __ATOMIC_RELEASE);
+        traiter_completion(cqe.user_data, cqe.res);
+    }
+}
 
+// Boucle d'événements du moteur io_uring : réceptions, envois, lectures, écritures et tics passent tous par l'anneau
+void boucle_anneau() {
+    for (int i = 0; i < TAILLE_LOT; i++) {
+        armer_requete(i);
+    }
     while (1) {
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
+        // Un tic n'est soumis que si des timers sont armés, le serveur inactif ne se réveille pas
+        if (timers_armes > 0 && !tic_arme) {
+            armer_tic();
+        }
+        // Soumission des opérations préparées et attente d'au moins une complétion, en un seul appel système
+        soumettre_anneau(1);
+        traiter_completions();
+
+        for (int i = 0; i < nb_a_relancer; i++) {
+            struct session *s = &sessions[sessions_a_relancer[i]];
+            s->relance = 0;
+            if (s->etat == SESSION_ENVOI) {
+                relancer_fenetre(s);
+            }
+        }
+        nb_a_relancer = 0;
 
-        // Attendre une activité sur un des sockets
-        int activity = select(max_sd + 1, &readfds, NULL, NULL, NULL);
-        if (activity < 0) {
-            erreur("Erreur lors de l'appel à select()");
+        if (timers_armes > 0) {
+            traiter_timers();
         }
+    }
+}
+
+// Fonction pour attacher au groupe SO_REUSEPORT un programme BPF qui choisit le socket du cœur ayant reçu le paquet
+void attacher_filtre_cpu(int sockfd, int nb_reacteurs) {
+    // Index du socket dans le groupe = numéro du cœur modulo le nombre de réacteurs (ordre des bind)
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, nb_reacteurs },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog programme = { sizeof(code) / sizeof(code[0]), code };
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &programme, sizeof(programme)) < 0) {
+        perror("Filtre BPF de répartition par cœur non supporté, répartition par hachage");
+    }
+}
 
-        if (FD_ISSET(sockfd, &readfds)) {
-            struct sockaddr_in addr_client;
-            struct tftp_request buffer;
-            socklen_t longueur_client = sizeof(struct sockaddr_in);
+// Fonction pour faire tourner la boucle d'événements epoll d'un réacteur
+void boucle_epoll(int sockfd) {
+    int epollfd = epoll_create1(0);
+    if (epollfd < 0) {
+        erreur("Erreur lors de la création de l'instance epoll");
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = SESSION_ECOUTE;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        erreur("Erreur lors de l'ajout du socket d'écoute à epoll");
+    }
+
+    // Le timerfd cadence la roue avec une résolution inférieure à la milliseconde, tant que des timers sont armés
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (timerfd < 0) {
+        erreur("Erreur lors de la création du timerfd");
+    }
+    ev.events = EPOLLIN;
+    ev.data.u32 = SESSION_TIMER;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, timerfd, &ev) < 0) {
+        erreur("Erreur lors de l'ajout du timerfd à epoll");
+    }
+    int roue_active = 0;
 
-            // Recevoir la requête du client
-            int bytes_recus = recvfrom(sockfd, &buffer, sizeof(struct tftp_request), 0, (struct sockaddr *)&addr_client, &longueur_client);
-            if (bytes_recus < 0) {
-                erreur("Erreur de réception des données");
+    struct epoll_event evenements[MAX_EVENEMENTS];
+    while (1) {
+        // Le timerfd n'est armé que si des timers le sont, le serveur inactif ne se réveille pas
+        if ((timers_armes > 0) != roue_active) {
+            roue_active = timers_armes > 0;
+            struct itimerspec cadence;
+            memset(&cadence, 0, sizeof(cadence));
+            if (roue_active) {
+                cadence.it_value.tv_nsec = RESOLUTION_ROUE_US * 1000L;
+                cadence.it_interval.tv_nsec = RESOLUTION_ROUE_US * 1000L;
+            }
+            timerfd_settime(timerfd, 0, &cadence, NULL);
+        }
+
+        // Attendre une activité sur un des sockets ou le prochain tic de la roue
+        int nb = epoll_wait(epollfd, evenements, MAX_EVENEMENTS, -1);
+        if (nb < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            erreur("Erreur lors de l'appel à epoll_wait()");
+        }
+
+        for (int i = 0; i < nb; i++) {
+            if (evenements[i].data.u32 == SESSION_TIMER) {
+                uint64_t tics;
+                if (read(timerfd, &tics, sizeof(tics)) < 0 && errno != EAGAIN) {
+                    perror("Erreur de lecture du timerfd");
+                }
+                continue;
+            }
+            if (evenements[i].data.u32 != SESSION_ECOUTE) {
+                struct session *s = &sessions[evenements[i].data.u32];
+                if (s->etat != SESSION_LIBRE) {
+                    traiter_session(s);
+                }
+                continue;
             }
 
-            // Traiter la requête du client
-            if (buffer.opcode == htons(OPCODE_WRQ)) {
-                // Requête d'écriture (WRQ) reçue
-                recevoir_wrq(sockfd, &addr_client, buffer.filename, "Octet");
-            } else if (buffer.opcode == htons(OPCODE_RRQ)) {
-                // Requête de lecture (RRQ) reçue
-                recevoir_rrq(sockfd, &addr_client, buffer.filename, "Octet");
+            // Nouvelles requêtes sur le port d'écoute, lues par lots
+            int nb_recus;
+            do {
+                nb_recus = recevoir_lot(sockfd);
+                for (int j = 0; j < nb_recus; j++) {
+                    traiter_requete(epollfd, tampons_reception[j], messages_reception[j].msg_len, &sources_reception[j]);
+                }
+            } while (nb_recus == TAILLE_LOT);
+        }
+
+        if (timers_armes > 0) {
+            traiter_timers();
+        }
+    }
+}
+
+// Fonction exécutée par chaque réacteur
+void *reacteur(void *arg) {
+    struct parametres_reacteur *parametres = (struct parametres_reacteur *)arg;
+    if (parametres->cpu >= 0) {
+        // Réacteur épinglé sur son cœur : ses sessions restent dans les caches de ce cœur
+        cpu_set_t ensemble;
+        CPU_ZERO(&ensemble);
+        CPU_SET(parametres->cpu, &ensemble);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(ensemble), &ensemble) != 0) {
+            fprintf(stderr, "Impossible d'épingler le réacteur sur le cœur %d\n", parametres->cpu);
+        }
+    }
+
+    sessions = calloc(MAX_CLIENTS, sizeof(struct session));
+    tampons_reception = malloc(TAILLE_LOT * sizeof(*tampons_reception));
+    if (sessions == NULL || tampons_reception == NULL) {
+        erreur("Erreur lors de l'allocation de la table des sessions");
+    }
+
+    // En-têtes du lot de réception, réutilisés à chaque appel recvmmsg
+    for (int i = 0; i < TAILLE_LOT; i++) {
+        iov_reception[i].iov_base = tampons_reception[i];
+        iov_reception[i].iov_len = sizeof(tampons_reception[i]);
+        messages_reception[i].msg_hdr.msg_name = &sources_reception[i];
+        messages_reception[i].msg_hdr.msg_iov = &iov_reception[i];
+        messages_reception[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // Un anneau io_uring par réacteur
+    if (anneau_demande) {
+        if (initialiser_anneau(parametres->sockfd) < 0 || sonder_annulation() < 0) {
+            perror("io_uring indisponible, utilisation d'epoll");
+        } else {
+            mode_anneau = 1;
+            boucle_anneau();
+        }
+    }
+    boucle_epoll(parametres->sockfd);
+    return NULL;
+}
+
+// Fonction principale
+int main(int argc, char *argv[]) {
+    int nb_reacteurs = 1;
+    int repartition_cpu = 0;
+
+    // Lecture des options de la ligne de commande
+    static struct option options_longues[] = {
+        {"quiet", no_argument, NULL, 'Q'},
+        {"metriques", required_argument, NULL, 'U'},
+        {"journal", required_argument, NULL, 'L'},
+        {NULL, 0, NULL, 0}
+    };
+    char *chemin_metriques = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "ur:as:QU:L:", options_longues, NULL)) != -1) {
+        if (opt == 'u') {
+            anneau_demande = 1;
+        } else if (opt == 'r') {
+            nb_reacteurs = atoi(optarg);
+        } else if (opt == 'a') {
+            repartition_cpu = 1;
+        } else if (opt == 's') {
+            // Durabilité des WRQ : "aucune", "fin" ou un intervalle de synchronisation en Mo
+            if (strcmp(optarg, "aucune") == 0) {
+                mode_durabilite = DURABILITE_AUCUNE;
+            } else if (strcmp(optarg, "fin") == 0) {
+                mode_durabilite = DURABILITE_FIN;
+            } else if (atol(optarg) > 0) {
+                mode_durabilite = DURABILITE_PERIODIQUE;
+                intervalle_sync = atol(optarg) * 1024LL * 1024;
             } else {
-                printf("Requette inconnue\n");
+                optind = argc + 1;
+                break;
+            }
+        } else if (opt == 'Q') {
+            niveau_journal = NIVEAU_ERREUR;
+        } else if (opt == 'L') {
+            // Niveau du journal : erreur, info (par défaut) ou debug pour les événements par bloc
+            niveau_journal = -1;
+            for (int i = NIVEAU_ERREUR; i <= NIVEAU_DEBUG; i++) {
+                if (strcmp(optarg, noms_niveaux[i]) == 0) {
+                    niveau_journal = i;
+                }
             }
+            if (niveau_journal < 0) {
+                optind = argc + 1;
+                break;
+            }
+        } else if (opt == 'U') {
+            chemin_metriques = optarg;
+        } else {
+            optind = argc + 1;
+            break;
         }
     }
+    if (argc - optind != 1 || nb_reacteurs < 1) {
+        fprintf(stderr, "Usage: %s [-u] [-r nb_reacteurs] [-a] [-s aucune|fin|intervalle_sync_Mo] [-Q|--quiet] [-L erreur|info|debug] [-U socket_metriques] <port>\n", argv[0]);
+        exit(1);
+    }
 
-    close(sockfd);
+    // Chaque session utilise un descripteur : on relève la limite au maximum autorisé
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+
+    // Un socket d'écoute par réacteur, liés dans l'ordre : le socket i est l'index i du groupe SO_REUSEPORT
+    struct parametres_reacteur *parametres = malloc(nb_reacteurs * sizeof(struct parametres_reacteur));
+    if (parametres == NULL) {
+        erreur("Erreur lors de l'allocation des réacteurs");
+    }
+    long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; i < nb_reacteurs; i++) {
+        struct sockaddr_in addr_serveur;
+        initialiser_socket(&parametres[i].sockfd, &addr_serveur, atoi(argv[optind]), nb_reacteurs > 1);
+        fcntl(parametres[i].sockfd, F_SETFL, fcntl(parametres[i].sockfd, F_GETFL) | O_NONBLOCK);
+        parametres[i].cpu = nb_reacteurs > 1 && nb_cpus > 0 ? i % nb_cpus : -1;
+    }
+    if (repartition_cpu && nb_reacteurs > 1) {
+        partage_requetes = 1;
+        attacher_filtre_cpu(parametres[0].sockfd, nb_reacteurs);
+    }
+    if (chemin_metriques != NULL) {
+        demarrer_metriques(chemin_metriques);
+    }
+    demarrer_journal();
+
+    printf("Serveur TFTP démarré sur le port %s avec %d réacteur%s%s...\n", argv[optind], nb_reacteurs,
+           nb_reacteurs > 1 ? "s" : "", anneau_demande ? " (io_uring)" : "");
+
+    if (nb_reacteurs == 1) {
+        // Un seul réacteur : il tourne dans le thread principal
+        reacteur(&parametres[0]);
+    }
+    pthread_t *threads = malloc(nb_reacteurs * sizeof(pthread_t));
+    if (threads == NULL) {
+        erreur("Erreur lors de l'allocation des réacteurs");
+    }
+    for (int i = 0; i < nb_reacteurs; i++) {
+        if (pthread_create(&threads[i], NULL, reacteur, &parametres[i]) != 0) {
+            erreur("Erreur lors de la création d'un réacteur");
+        }
+    }
+    for (int i = 0; i < nb_reacteurs; i++) {
+        pthread_join(threads[i], NULL);
+    }
 
     return 0;
 }
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // sendmmsg/recvmmsg
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,50 +7,199 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pthread.h>
+#include <errno.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <netinet/udp.h>
+#include <sys/un.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include "tftp.h"
+#include "session.h"
+#include "metriques.h"
+#include "journal.h"
+#include "limiteur.h"
 
-#define TAILLE_PAQUET 516
-#define TIMEOUT_SEC 5
-#define MAX_TENTATIVES 5
+#define NB_TRAVAILLEURS_DEFAUT 16     // Nombre de threads de travail du pool
+#define PROFONDEUR_FILE_DEFAUT 1024   // Nombre de requêtes en attente avant de refuser les clients
+#define TAILLE_PILE_TRAVAILLEUR (256 * 1024)
+#define TAILLE_TABLE_VERROUS 256      // Nombre de seaux de la table des verrous de fichiers
+#define TAILLE_CACHE_DEFAUT 128       // Taille du cache de fichiers en Mo (0 pour le désactiver)
+#define SEAUX_CACHE 64
+#define SEAUX_SESSIONS 1024           // Nombre de seaux de la table des sessions actives
+#define MAX_MEMBRES_GROUPE 1024       // Clients d'un même groupe multicast (RFC 2090)
+#define TAILLE_LOT WINDOWSIZE_MAX     // Datagrammes par appel sendmmsg/recvmmsg : une fenêtre complète tient dans un lot
+#define SEGMENTS_GSO_MAX 64           // Nombre maximal de datagrammes découpés par le noyau dans un envoi UDP_SEGMENT
+#define TAILLE_GSO_MAX 65507          // Taille maximale d'un envoi UDP_SEGMENT (charge utile d'un datagramme IPv4)
+#define TAILLE_TAMPON_ECRITURE (1024 * 1024) // Taille des écritures groupées d'une WRQ, multiple de la taille de page
+#define ALIGNEMENT_ECRITURE 4096
 
-#define OPCODE_RRQ 1
-#define OPCODE_WRQ 2
-#define OPCODE_DATA 3
-#define OPCODE_ACK 4
-#define OPCODE_ERROR 5
+#define DURABILITE_AUCUNE 0     // Les données reçues restent dans le cache de pages du noyau
+#define DURABILITE_FIN 1        // fdatasync avant la publication du fichier reçu
+#define DURABILITE_PERIODIQUE 2 // fdatasync tous les N Mo écrits, puis avant la publication
 
-// Mutex pour synchroniser l'accès aux fichiers partagés
-pthread_mutex_t fichier_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Verrou lecteurs/rédacteur d'un fichier, identifié par son couple (périphérique, inode)
+struct verrou_fichier {
+    dev_t dev;
+    ino_t ino;
+    int references;                  // Nombre de sessions utilisant l'entrée
+    pthread_rwlock_t verrou;
+    char *projection;                // Projection mémoire partagée par les sessions en mode mmap
+    off_t taille_projection;
+    struct verrou_fichier *suivant;  // Entrée suivante du même seau
+};
 
-// Fonction pour gérer les erreurs et quitter le programme
-void erreur(const char *msg) {
-    perror(msg);
-    exit(1);
-}
+// Table des verrous de fichiers : chaque seau a son propre mutex, tenu uniquement pendant la recherche
+struct verrou_fichier *table_verrous[TAILLE_TABLE_VERROUS];
+pthread_mutex_t mutex_seaux[TAILLE_TABLE_VERROUS];
+
+// Session en file ou en cours, identifiée par le client, l'opcode et le nom du fichier
+struct session_active {
+    struct sockaddr_in addr_client;
+    int opcode;
+    struct session_active *suivant;  // Entrée suivante du même seau
+    char nom_fichier[];
+};
+
+// Table des sessions actives : une requête retransmise par un client ne crée pas une seconde session
+struct session_active *table_sessions[SEAUX_SESSIONS];
+pthread_mutex_t mutex_sessions[SEAUX_SESSIONS];
+
+// Groupes multicast en cours, protégés par un seul mutex (inscriptions et changements de maître sont rares)
+struct groupe_multicast *groupes = NULL;
+pthread_mutex_t mutex_groupes = PTHREAD_MUTEX_INITIALIZER;
+struct sockaddr_in addr_multicast;  // Adresse des groupes et premier port (-M), port 0 si le multicast est désactivé
+int prochain_port_multicast = 0;
 
-// Structure de la requête RRQ/WRQ
-struct tftp_request {
-    unsigned short opcode;
-    char filename[TAILLE_PAQUET - 2];
+// Entrée du cache : contenu complet d'un fichier, partagé en lecture seule par toutes les sessions
+struct entree_cache {
+    char chemin[TAILLE_PAQUET];
+    struct timespec mtime;            // Date de modification du fichier au moment du chargement
+    off_t taille;
+    char *contenu;                    // NULL si le chargement a échoué
+    int references;                   // Nombre de sessions utilisant l'entrée
+    int chargee;                      // 0 tant que la première session lit le fichier
+    int dans_table;                   // 0 une fois l'entrée invalidée ou évincée
+    struct entree_cache *suivant_seau;
+    struct entree_cache *precedent_lru; // Vers les entrées plus récemment utilisées
+    struct entree_cache *suivant_lru;
 };
 
-// Structure du paquet DATA
-struct tftp_data_packet {
-    unsigned short opcode;
-    unsigned short block_num;
-    char data[TAILLE_PAQUET - 4];
+// Cache LRU de fichiers borné en taille, commun à tout le processus
+struct cache_fichiers {
+    pthread_mutex_t mutex;
+    pthread_cond_t chargement;        // Signalé quand une entrée a fini d'être chargée
+    struct entree_cache *seaux[SEAUX_CACHE];
+    struct entree_cache *tete_lru;    // Entrée la plus récemment utilisée
+    struct entree_cache *queue_lru;   // Entrée la moins récemment utilisée
+    long taille_totale;
+    long capacite;
 };
 
-// Structure du paquet ACK
-struct tftp_ack_packet {
-    unsigned short opcode;
-    unsigned short block_num;
+struct cache_fichiers cache = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+// Mode de lecture des RRQ : 1 pour envoyer les blocs depuis une projection mmap du fichier
+int mode_mmap = 0;
+
+// Mode d'envoi des RRQ : 1 pour confier au noyau le découpage des fenêtres en datagrammes (UDP_SEGMENT)
+int mode_gso = 0;
+
+// Contrôle de congestion des RRQ : aucun, aimd ou delai
+int mode_congestion = CONGESTION_AUCUN;
+
+// Synchronisation sur disque des fichiers reçus par WRQ
+int mode_durabilite = DURABILITE_AUCUNE;
+long long intervalle_sync = 0; // Octets écrits entre deux fdatasync en mode périodique
+
+// Session traitée par le thread, 0 pour le thread principal
+__thread unsigned int session_courante = 0;
+
+// Groupe multicast (RFC 2090) : une seule session envoie le fichier à tous les clients du groupe,
+// les ACK du maître pilotent l'envoi et les autres clients écoutent le flux en attendant leur tour
+struct groupe_multicast {
+    char nom_fichier[TAILLE_PAQUET];
+    int blksize;
+    int windowsize;
+    int sockfd;                      // Socket de la session qui sert le groupe (TID du serveur)
+    struct sockaddr_in addr_groupe;  // Adresse et port multicast des paquets DATA
+    struct sockaddr_in membres[MAX_MEMBRES_GROUPE]; // Clients inscrits, le maître en premier
+    int nb_membres;
+    int nb_clients;                  // Statistiques : clients inscrits depuis la création du groupe
+    struct groupe_multicast *suivant;
 };
 
 // Structure pour passer les données du socket aux threads de traitement
 struct thread_data {
-    struct tftp_request requete;
+    char requete[TAILLE_PAQUET];
+    int taille_requete;
     struct sockaddr_in addr_client;
+    struct session_active *session; // Entrée de la table des sessions, NULL pour une requête mal formée
+};
+
+// Lot de paquets DATA envoyés en un seul appel sendmmsg
+struct lot_envoi {
+    struct mmsghdr messages[TAILLE_LOT];
+    struct iovec iov[TAILLE_LOT][2];            // En-tête et données de chaque paquet, sans recopie
+    struct tftp_ack_packet entetes[TAILLE_LOT]; // Même en-tête de 4 octets que le paquet DATA
+    int nb_paquets;
+    int taille_segment;                         // Taille d'un paquet DATA complet en mode GSO, 0 sans GSO
+    struct mmsghdr messages_gso[TAILLE_LOT];    // Envois regroupant plusieurs paquets découpés par le noyau
+    char controles_gso[TAILLE_LOT][CMSG_SPACE(sizeof(uint16_t))];
+    long nb_appels;                             // Statistiques : nombre d'appels sendmmsg
+    long total_paquets;                         // Statistiques : nombre de paquets envoyés
+    long nb_envois_gso;                         // Statistiques : nombre d'envois UDP_SEGMENT
+};
+
+// Lot de datagrammes reçus en un seul appel recvmmsg
+struct lot_reception {
+    struct mmsghdr messages[TAILLE_LOT];
+    struct iovec iov[TAILLE_LOT];
+    struct sockaddr_in sources[TAILLE_LOT];
+    char tampons[TAILLE_LOT][TAILLE_PAQUET];
+    long nb_appels;                             // Statistiques : nombre d'appels recvmmsg
+    long total_paquets;                         // Statistiques : nombre de datagrammes reçus
+};
+
+// Pipeline d'écriture d'une WRQ : la réception remplit un tampon pendant que le thread d'E/S écrit l'autre
+struct pipeline_ecriture {
+    int fd;
+    char *tampons[2];
+    int courant;               // Tampon rempli par le thread de réception
+    size_t remplissage;        // Octets déjà copiés dans le tampon courant
+    pthread_t thread;
+    pthread_mutex_t verrou;    // Protège les champs suivants, partagés avec le thread d'E/S
+    pthread_cond_t condition;
+    int a_ecrire;              // 1 si un tampon attend d'être écrit
+    int tampon_a_ecrire;
+    size_t taille_a_ecrire;
+    int fin;                   // 1 quand la réception est terminée
+    int erreur;                // errno de la première écriture ou synchronisation échouée, 0 sinon
+    off_t position;            // Position dans le fichier du prochain tampon écrit
+    long long depuis_sync;     // Octets écrits depuis le dernier fdatasync
+    long nb_ecritures;         // Statistiques : nombre d'appels pwrite
+};
+
+// Case de la file de requêtes : le numéro de séquence indique si elle est libre ou occupée
+struct case_file {
+    atomic_size_t sequence;
+    struct thread_data donnees;
+};
+
+// File de requêtes bornée multi-producteurs/multi-consommateurs sans verrou (algorithme de Vyukov)
+struct file_requetes {
+    struct case_file *cases;
+    size_t masque;                   // Capacité - 1, la capacité étant une puissance de 2
+    atomic_size_t position_ajout;
+    atomic_size_t position_retrait;
+    sem_t requetes_disponibles;      // Réveille les threads de travail quand la file n'est pas vide
 };
 
 // Fonction pour initialiser le socket
@@ -74,196 +224,1461 @@ int initialiser_socket(int *sockfd, struct sockaddr_in *addr_serveur, int port)
     return *sockfd;
 }
 
-// Fonction pour envoyer un paquet de données au client avec timeout
-void envoyer_paquet_donnees(int sockfd, struct sockaddr_in *addr_client, struct tftp_data_packet *data_packet, int data_size, const char *nom_fichier) {
-    int tentatives = 0;
-    while (tentatives < MAX_TENTATIVES) {
-        if (sendto(sockfd, data_packet, data_size, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in)) < 0) {
-            perror("Erreur lors de l'envoi du paquet de données");
-            tentatives++;
-            sleep(TIMEOUT_SEC);
+// Fonction pour initialiser les mutex des seaux de la table des verrous
+void initialiser_table_verrous() {
+    for (int i = 0; i < TAILLE_TABLE_VERROUS; i++) {
+        pthread_mutex_init(&mutex_seaux[i], NULL);
+    }
+}
+
+// Fonction pour calculer le seau de la table des verrous associé à un fichier
+int seau_verrou(dev_t dev, ino_t ino) {
+    return (int)((dev * 31 + ino) % TAILLE_TABLE_VERROUS);
+}
+
+// Fonction pour obtenir (et créer si besoin) le verrou associé à un fichier ouvert
+struct verrou_fichier *acquerir_verrou_fichier(dev_t dev, ino_t ino) {
+    int seau = seau_verrou(dev, ino);
+    pthread_mutex_lock(&mutex_seaux[seau]);
+    struct verrou_fichier *v = table_verrous[seau];
+    while (v != NULL && (v->dev != dev || v->ino != ino)) {
+        v = v->suivant;
+    }
+    if (v == NULL) {
+        v = malloc(sizeof(struct verrou_fichier));
+        if (v == NULL) {
+            erreur("Erreur lors de l'allocation d'un verrou de fichier");
+        }
+        v->dev = dev;
+        v->ino = ino;
+        v->references = 0;
+        v->projection = NULL;
+        v->taille_projection = 0;
+        pthread_rwlock_init(&v->verrou, NULL);
+        v->suivant = table_verrous[seau];
+        table_verrous[seau] = v;
+    }
+    v->references++;
+    pthread_mutex_unlock(&mutex_seaux[seau]);
+    return v;
+}
+
+// Fonction pour rendre un verrou de fichier, l'entrée est supprimée quand plus aucune session ne l'utilise
+void liberer_verrou_fichier(struct verrou_fichier *v) {
+    int seau = seau_verrou(v->dev, v->ino);
+    pthread_mutex_lock(&mutex_seaux[seau]);
+    if (--v->references == 0) {
+        struct verrou_fichier **courant = &table_verrous[seau];
+        while (*courant != v) {
+            courant = &(*courant)->suivant;
+        }
+        *courant = v->suivant;
+        if (v->projection != NULL) {
+            munmap(v->projection, v->taille_projection);
+        }
+        pthread_rwlock_destroy(&v->verrou);
+        free(v);
+    }
+    pthread_mutex_unlock(&mutex_seaux[seau]);
+}
+
+// Fonction pour obtenir la projection mémoire d'un fichier, créée une seule fois pour toutes ses sessions
+// Le fichier n'est jamais modifié en place par le serveur (les WRQ le remplacent par renommage)
+char *projeter_fichier(struct verrou_fichier *v, int fd, off_t taille) {
+    int seau = seau_verrou(v->dev, v->ino);
+    pthread_mutex_lock(&mutex_seaux[seau]);
+    if (v->projection == NULL && taille > 0) {
+        char *projection = mmap(NULL, taille, PROT_READ, MAP_SHARED, fd, 0);
+        if (projection != MAP_FAILED) {
+            madvise(projection, taille, MADV_SEQUENTIAL);
+            v->projection = projection;
+            v->taille_projection = taille;
+        }
+    }
+    char *projection = v->projection;
+    pthread_mutex_unlock(&mutex_seaux[seau]);
+    return projection;
+}
+
+// Fonction pour remplacer atomiquement un fichier par le fichier temporaire d'une WRQ terminée
+int publier_fichier(const char *chemin_temporaire, const char *nom_fichier) {
+    struct stat infos;
+    if (stat(nom_fichier, &infos) < 0) {
+        // Nouveau fichier : aucun lecteur ne peut l'avoir ouvert
+        return rename(chemin_temporaire, nom_fichier);
+    }
+    // Verrou exclusif sur l'ancien fichier : on attend la fin des lectures de blocs en cours
+    struct verrou_fichier *v = acquerir_verrou_fichier(infos.st_dev, infos.st_ino);
+    pthread_rwlock_wrlock(&v->verrou);
+    int resultat = rename(chemin_temporaire, nom_fichier);
+    pthread_rwlock_unlock(&v->verrou);
+    liberer_verrou_fichier(v);
+    return resultat;
+}
+
+// Fonction pour calculer le seau du cache associé à un chemin
+unsigned int seau_cache(const char *chemin) {
+    unsigned int hache = 5381;
+    while (*chemin) {
+        hache = hache * 33 + (unsigned char)*chemin++;
+    }
+    return hache % SEAUX_CACHE;
+}
+
+// Fonction pour retirer une entrée de la table et de la liste LRU (mutex du cache tenu)
+void retirer_entree_cache(struct entree_cache *e) {
+    struct entree_cache **courant = &cache.seaux[seau_cache(e->chemin)];
+    while (*courant != e) {
+        courant = &(*courant)->suivant_seau;
+    }
+    *courant = e->suivant_seau;
+    if (e->precedent_lru != NULL) {
+        e->precedent_lru->suivant_lru = e->suivant_lru;
+    } else {
+        cache.tete_lru = e->suivant_lru;
+    }
+    if (e->suivant_lru != NULL) {
+        e->suivant_lru->precedent_lru = e->precedent_lru;
+    } else {
+        cache.queue_lru = e->precedent_lru;
+    }
+    cache.taille_totale -= e->taille;
+    e->dans_table = 0;
+    if (e->references == 0) {
+        free(e->contenu);
+        free(e);
+    }
+}
+
+// Fonction pour placer une entrée en tête de la liste LRU (mutex du cache tenu)
+void promouvoir_entree_cache(struct entree_cache *e) {
+    if (cache.tete_lru == e) {
+        return;
+    }
+    e->precedent_lru->suivant_lru = e->suivant_lru;
+    if (e->suivant_lru != NULL) {
+        e->suivant_lru->precedent_lru = e->precedent_lru;
+    } else {
+        cache.queue_lru = e->precedent_lru;
+    }
+    e->precedent_lru = NULL;
+    e->suivant_lru = cache.tete_lru;
+    cache.tete_lru->precedent_lru = e;
+    cache.tete_lru = e;
+}
+
+// Fonction pour évincer les entrées inutilisées les plus anciennes tant que le cache dépasse sa capacité
+void evincer_cache() {
+    struct entree_cache *e = cache.queue_lru;
+    while (e != NULL && cache.taille_totale > cache.capacite) {
+        struct entree_cache *precedent = e->precedent_lru;
+        if (e->references == 0 && e->chargee) {
+            retirer_entree_cache(e);
+        }
+        e = precedent;
+    }
+}
+
+// Fonction pour rendre une entrée du cache à la fin d'une session
+void liberer_entree_cache(struct entree_cache *e) {
+    pthread_mutex_lock(&cache.mutex);
+    if (--e->references == 0) {
+        if (!e->dans_table) {
+            free(e->contenu);
+            free(e);
         } else {
-            if (data_packet->opcode == htons(OPCODE_DATA)) {
-                printf("Envoi des données du fichier '%s' au client...\n", nom_fichier);
-            } else if (data_packet->opcode == htons(OPCODE_ACK)) {
-                printf("Réception de l'ACK du client pour le fichier '%s'\n", nom_fichier);
+            evincer_cache();
+        }
+    }
+    pthread_mutex_unlock(&cache.mutex);
+}
+
+// Fonction pour obtenir le contenu d'un fichier depuis le cache, en le chargeant au premier accès
+// Retourne NULL si le fichier ne doit pas être mis en cache : il est alors lu bloc par bloc
+struct entree_cache *obtenir_entree_cache(const char *nom_fichier, FILE *fichier, const struct stat *infos) {
+    if (infos->st_size > cache.capacite / 4 || strlen(nom_fichier) >= TAILLE_PAQUET) {
+        return NULL;
+    }
+    pthread_mutex_lock(&cache.mutex);
+    struct entree_cache *e = cache.seaux[seau_cache(nom_fichier)];
+    while (e != NULL && strcmp(e->chemin, nom_fichier) != 0) {
+        e = e->suivant_seau;
+    }
+    if (e != NULL && (e->mtime.tv_sec != infos->st_mtim.tv_sec || e->mtime.tv_nsec != infos->st_mtim.tv_nsec || e->taille != infos->st_size)) {
+        // Le fichier a été modifié depuis son chargement
+        retirer_entree_cache(e);
+        e = NULL;
+    }
+
+    if (e != NULL) {
+        // Succès : attendre éventuellement la fin du chargement par une autre session
+        compter(&compteurs()->cache_succes, 1);
+        e->references++;
+        while (!e->chargee) {
+            pthread_cond_wait(&cache.chargement, &cache.mutex);
+        }
+        if (e->contenu == NULL) {
+            pthread_mutex_unlock(&cache.mutex);
+            liberer_entree_cache(e);
+            return NULL;
+        }
+        if (e->dans_table) {
+            promouvoir_entree_cache(e);
+        }
+        pthread_mutex_unlock(&cache.mutex);
+        return e;
+    }
+
+    // Échec : l'entrée est réservée avant le chargement pour que les autres sessions l'attendent
+    compter(&compteurs()->cache_echecs, 1);
+    e = calloc(1, sizeof(struct entree_cache));
+    if (e == NULL) {
+        pthread_mutex_unlock(&cache.mutex);
+        return NULL;
+    }
+    strcpy(e->chemin, nom_fichier);
+    e->mtime = infos->st_mtim;
+    e->taille = infos->st_size;
+    e->references = 1;
+    e->dans_table = 1;
+    unsigned int seau = seau_cache(nom_fichier);
+    e->suivant_seau = cache.seaux[seau];
+    cache.seaux[seau] = e;
+    e->suivant_lru = cache.tete_lru;
+    if (cache.tete_lru != NULL) {
+        cache.tete_lru->precedent_lru = e;
+    } else {
+        cache.queue_lru = e;
+    }
+    cache.tete_lru = e;
+    cache.taille_totale += e->taille;
+    pthread_mutex_unlock(&cache.mutex);
+
+    // Lecture du fichier complet hors du mutex
+    char *contenu = malloc(e->taille > 0 ? e->taille : 1);
+    off_t lus = 0;
+    while (contenu != NULL && lus < e->taille) {
+        ssize_t n = pread(fileno(fichier), contenu + lus, e->taille - lus, lus);
+        if (n <= 0) {
+            free(contenu);
+            contenu = NULL;
+            break;
+        }
+        lus += n;
+    }
+
+    pthread_mutex_lock(&cache.mutex);
+    e->contenu = contenu;
+    e->chargee = 1;
+    if (contenu == NULL && e->dans_table) {
+        retirer_entree_cache(e);
+    }
+    pthread_cond_broadcast(&cache.chargement);
+    evincer_cache();
+    pthread_mutex_unlock(&cache.mutex);
+    if (contenu == NULL) {
+        liberer_entree_cache(e);
+        return NULL;
+    }
+    return e;
+}
+
+// Fonction pour invalider l'entrée du cache d'un fichier remplacé par une WRQ
+void invalider_cache(const char *nom_fichier) {
+    pthread_mutex_lock(&cache.mutex);
+    struct entree_cache *e = cache.seaux[seau_cache(nom_fichier)];
+    while (e != NULL && strcmp(e->chemin, nom_fichier) != 0) {
+        e = e->suivant_seau;
+    }
+    if (e != NULL) {
+        retirer_entree_cache(e);
+    }
+    pthread_mutex_unlock(&cache.mutex);
+}
+
+// Fonction pour ajouter un paquet DATA au lot ; les données restent dans le cache, la projection ou le tampon de lecture
+void ajouter_au_lot(struct lot_envoi *lot, struct sockaddr_in *addr_client, unsigned short numero_bloc, const char *donnees, int taille) {
+    int i = lot->nb_paquets++;
+    lot->entetes[i].opcode = htons(OPCODE_DATA);
+    lot->entetes[i].block_num = htons(numero_bloc);
+    lot->iov[i][0].iov_base = &lot->entetes[i];
+    lot->iov[i][0].iov_len = 4;
+    lot->iov[i][1].iov_base = (char *)donnees;
+    lot->iov[i][1].iov_len = taille;
+    memset(&lot->messages[i].msg_hdr, 0, sizeof(struct msghdr));
+    lot->messages[i].msg_hdr.msg_name = addr_client;
+    lot->messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    lot->messages[i].msg_hdr.msg_iov = lot->iov[i];
+    lot->messages[i].msg_hdr.msg_iovlen = 2;
+}
+
+// Fonction pour envoyer des messages avec le moins d'appels sendmmsg possible, renvoie le nombre de messages envoyés
+int envoyer_messages(int sockfd, struct mmsghdr *messages, int nb_messages, struct lot_envoi *lot) {
+    int envoyes = 0;
+    while (envoyes < nb_messages) {
+        int n = sendmmsg(sockfd, messages + envoyes, nb_messages - envoyes, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
             }
             break;
         }
+        envoyes += n;
+        lot->nb_appels++;
     }
-    if (tentatives == MAX_TENTATIVES) {
-        fprintf(stderr, "Échec de l'envoi du paquet de données après %d tentatives. Le client semble indisponible.\n", MAX_TENTATIVES);
-        exit(1);
+    return envoyes;
+}
+
+// Fonction pour regrouper les paquets debut à fin - 1 du lot en envois UDP_SEGMENT et les envoyer,
+// renvoie le nombre de paquets envoyés
+int envoyer_lot_gso(int sockfd, struct lot_envoi *lot, int debut_tranche, int fin_tranche) {
+    int nb_messages = 0;
+    int i = debut_tranche;
+    while (i < fin_tranche) {
+        // Le noyau découpe l'envoi en segments de taille_segment octets, seul le dernier peut être plus court
+        int debut = i;
+        size_t total = 0;
+        while (i < fin_tranche && i - debut < SEGMENTS_GSO_MAX) {
+            size_t longueur = 4 + lot->iov[i][1].iov_len;
+            if (total + longueur > TAILLE_GSO_MAX) {
+                break;
+            }
+            total += longueur;
+            i++;
+            if (longueur < (size_t)lot->taille_segment) {
+                break;
+            }
+        }
+        // Les deux iovec de chaque paquet se suivent dans le tableau : l'envoi reste sans recopie
+        struct msghdr *message = &lot->messages_gso[nb_messages].msg_hdr;
+        memset(message, 0, sizeof(struct msghdr));
+        message->msg_name = lot->messages[debut].msg_hdr.msg_name;
+        message->msg_namelen = sizeof(struct sockaddr_in);
+        message->msg_iov = lot->iov[debut];
+        message->msg_iovlen = 2 * (i - debut);
+        if (i - debut > 1) {
+            message->msg_control = lot->controles_gso[nb_messages];
+            message->msg_controllen = sizeof(lot->controles_gso[nb_messages]);
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(message);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t taille_segment = lot->taille_segment;
+            memcpy(CMSG_DATA(cmsg), &taille_segment, sizeof(taille_segment));
+        }
+        nb_messages++;
     }
+
+    int envoyes = envoyer_messages(sockfd, lot->messages_gso, nb_messages, lot);
+    lot->nb_envois_gso += envoyes;
+    int paquets_envoyes = 0;
+    for (int m = 0; m < envoyes; m++) {
+        paquets_envoyes += lot->messages_gso[m].msg_hdr.msg_iovlen / 2;
+    }
+    return paquets_envoyes;
 }
 
-// Fonction pour recevoir une demande d'écriture (WRQ) du client avec timeout
-int recevoir_wrq(struct sockaddr_in *addr_client, const char *nom_fichier, const char *mode) {
-    printf("Requête d'écriture (WRQ) reçue pour le fichier '%s'\n", nom_fichier);
-    char buffer[TAILLE_PAQUET];
-    socklen_t longueur_client = sizeof(struct sockaddr_in);
-    int numero_bloc = 0;
-    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        erreur("Erreur lors de la création du socket");
+// Fonction pour envoyer les paquets debut à fin - 1 du lot, en un seul appel sendmmsg dans le cas courant
+void envoyer_tranche(int sockfd, struct lot_envoi *lot, int debut, int fin) {
+    int envoyes = 0;
+    if (lot->taille_segment > 0) {
+        envoyes = envoyer_lot_gso(sockfd, lot, debut, fin);
+        if (envoyes < fin - debut && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+            // Carte réseau ou noyau sans segmentation UDP : la session repasse à l'envoi classique
+            journaliser(NIVEAU_ERREUR, session_courante, EV_ERREUR, 0, "UDP_SEGMENT refusé (%s), retour à l'envoi classique", strerror(errno));
+            lot->taille_segment = 0;
+        }
     }
-    FILE *fichier;
-    pthread_mutex_lock(&fichier_mutex); // Verrouiller le mutex avant d'accéder au fichier
-    fichier = fopen(nom_fichier, "r+b"); // Ouverture en mode lecture et écriture binaire
-    if (fichier == NULL) {
-        // Si le fichier n'existe pas, créez-le
-        fichier = fopen(nom_fichier, "wb");
-        if (fichier == NULL) {
-            erreur("Erreur lors de la création du fichier pour l'écriture");
+    if (lot->taille_segment == 0 && envoyes < fin - debut) {
+        envoyes += envoyer_messages(sockfd, lot->messages + debut + envoyes, fin - debut - envoyes, lot);
+    }
+    if (envoyes < fin - debut) {
+        // Les paquets non envoyés seront renvoyés à l'expiration du timeout
+        journaliser(NIVEAU_ERREUR, session_courante, EV_ERREUR, 0, "Erreur lors de l'envoi du lot de paquets: %s", strerror(errno));
+    }
+    lot->total_paquets += envoyes;
+}
+
+// Fonction pour envoyer tous les paquets du lot, renvoie l'instant de l'envoi en microsecondes.
+// Avec des limites de débit ou un rythme de congestion, le lot part par tranches, chacune à l'instant accordé
+// par les seaux de la session, de son sous-réseau et du serveur
+long envoyer_lot(int sockfd, struct lot_envoi *lot, struct regulation *regulation, int blksize) {
+    int tranche = regulation != NULL ? paquets_par_tranche(regulation, blksize + 4) : 0;
+    long instant = maintenant_us();
+    if (tranche == 0) {
+        envoyer_tranche(sockfd, lot, 0, lot->nb_paquets);
+    }
+    for (int debut = 0; tranche > 0 && debut < lot->nb_paquets; debut += tranche) {
+        int fin = debut + tranche < lot->nb_paquets ? debut + tranche : lot->nb_paquets;
+        long octets = 0;
+        for (int i = debut; i < fin; i++) {
+            octets += 4 + lot->iov[i][1].iov_len + ENTETES_IP_UDP;
+        }
+        long attente = attendre_depart(reserver_envoi(regulation, octets));
+        if (attente > 0) {
+            compter(&compteurs()->attente_regulation_ns, attente);
+            instant = maintenant_us();
         }
+        envoyer_tranche(sockfd, lot, debut, fin);
     }
-    pthread_mutex_unlock(&fichier_mutex); // Déverrouiller le mutex après avoir accédé au fichier
+    lot->nb_paquets = 0;
+    return instant;
+}
 
-    // Envoi de l'ACK pour WRQ
-    struct tftp_ack_packet ack_packet;
-    ack_packet.opcode = htons(OPCODE_ACK);
-    ack_packet.block_num = htons(0);
+// Fonction pour préparer les en-têtes d'un lot de réception, réutilisés à chaque appel recvmmsg
+void initialiser_lot_reception(struct lot_reception *lot) {
+    memset(lot->messages, 0, sizeof(lot->messages));
+    for (int i = 0; i < TAILLE_LOT; i++) {
+        lot->iov[i].iov_base = lot->tampons[i];
+        lot->iov[i].iov_len = TAILLE_PAQUET;
+        lot->messages[i].msg_hdr.msg_name = &lot->sources[i];
+        lot->messages[i].msg_hdr.msg_iov = &lot->iov[i];
+        lot->messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    lot->nb_appels = 0;
+    lot->total_paquets = 0;
+}
 
-    if (sendto(sockfd, &ack_packet, sizeof(ack_packet), 0, (struct sockaddr *)addr_client, longueur_client) < 0) {
-        erreur("Erreur lors de l'envoi de l'ACK pour WRQ");
+// Fonction pour recevoir tous les datagrammes en attente : bloque (avec timeout) jusqu'au premier, puis vide la file du socket
+int recevoir_lot(int sockfd, struct lot_reception *lot) {
+    for (int i = 0; i < TAILLE_LOT; i++) {
+        lot->messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
     }
+    int n = recvmmsg(sockfd, lot->messages, TAILLE_LOT, MSG_WAITFORONE, NULL);
+    if (n > 0) {
+        lot->nb_appels++;
+        lot->total_paquets += n;
+    }
+    return n;
+}
+
+// Fonction pour initialiser les mutex des seaux de la table des sessions
+void initialiser_table_sessions() {
+    for (int i = 0; i < SEAUX_SESSIONS; i++) {
+        pthread_mutex_init(&mutex_sessions[i], NULL);
+    }
+}
+
+// Fonction pour calculer le seau de la table des sessions associé à une requête
+unsigned int seau_session(const struct sockaddr_in *addr_client, int opcode, const char *nom_fichier) {
+    unsigned int hache = 5381;
+    while (*nom_fichier) {
+        hache = hache * 33 + (unsigned char)*nom_fichier++;
+    }
+    hache = hache * 33 + addr_client->sin_addr.s_addr;
+    hache = hache * 33 + addr_client->sin_port;
+    hache = hache * 33 + opcode;
+    return hache % SEAUX_SESSIONS;
+}
+
+// Fonction pour inscrire une requête dans la table des sessions, renvoie NULL si la même requête est déjà en cours
+struct session_active *inscrire_session(const struct sockaddr_in *addr_client, int opcode, const char *nom_fichier) {
+    unsigned int seau = seau_session(addr_client, opcode, nom_fichier);
+    pthread_mutex_lock(&mutex_sessions[seau]);
+    for (struct session_active *e = table_sessions[seau]; e != NULL; e = e->suivant) {
+        if (e->opcode == opcode && meme_client(&e->addr_client, addr_client) && strcmp(e->nom_fichier, nom_fichier) == 0) {
+            pthread_mutex_unlock(&mutex_sessions[seau]);
+            return NULL;
+        }
+    }
+    struct session_active *e = malloc(sizeof(struct session_active) + strlen(nom_fichier) + 1);
+    if (e == NULL) {
+        erreur("Erreur lors de l'allocation d'une entrée de la table des sessions");
+    }
+    e->addr_client = *addr_client;
+    e->opcode = opcode;
+    strcpy(e->nom_fichier, nom_fichier);
+    e->suivant = table_sessions[seau];
+    table_sessions[seau] = e;
+    pthread_mutex_unlock(&mutex_sessions[seau]);
+    return e;
+}
+
+// Fonction pour retirer une session terminée de la table
+void retirer_session(struct session_active *e) {
+    unsigned int seau = seau_session(&e->addr_client, e->opcode, e->nom_fichier);
+    pthread_mutex_lock(&mutex_sessions[seau]);
+    struct session_active **courant = &table_sessions[seau];
+    while (*courant != e) {
+        courant = &(*courant)->suivant;
+    }
+    *courant = e->suivant;
+    pthread_mutex_unlock(&mutex_sessions[seau]);
+    free(e);
+}
+
+// Fonction pour envoyer l'OACK d'une RRQ et attendre l'ACK du bloc 0
+int negocier_oack(int sockfd, struct sockaddr_in *addr_client, const struct options_tftp *options, struct estimateur_rtt *rtt) {
+    char oack[TAILLE_PAQUET];
+    char buffer[TAILLE_PAQUET];
+    struct sockaddr_in addr_source;
+    socklen_t longueur_source;
+    int taille_oack = construire_oack(oack, options);
+    int renvoye = 0; // L'ACK d'un OACK renvoyé ne donne pas de mesure de RTT (règle de Karn)
 
+    sendto(sockfd, oack, taille_oack, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in));
+    long instant_envoi = maintenant_us();
+    armer_rtt(rtt);
     while (1) {
-        int bytes_recus = recvfrom(sockfd, buffer, TAILLE_PAQUET, 0, (struct sockaddr *)addr_client, &longueur_client);
+        appliquer_rto(sockfd, rtt);
+        longueur_source = sizeof(addr_source);
+        int bytes_recus = recvfrom(sockfd, buffer, TAILLE_PAQUET, 0, (struct sockaddr *)&addr_source, &longueur_source);
         if (bytes_recus < 0) {
-            erreur("Erreur de réception des données");
+            if (expiration_rtt(rtt)) {
+                break;
+            }
+            sendto(sockfd, oack, taille_oack, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in));
+            compter(&compteurs()->retransmissions, 1);
+            renvoye = 1;
+            armer_rtt(rtt);
+            continue;
         }
+        struct paquet_decode paquet;
+        if (!meme_client(&addr_source, addr_client) || decoder_paquet(buffer, bytes_recus, &paquet) < 0) {
+            continue;
+        }
+        if (paquet.opcode == OPCODE_ACK && paquet.bloc == 0) {
+            if (!renvoye) {
+                mesurer_rtt(rtt, maintenant_us() - instant_envoi);
+            }
+            progression_rtt(rtt);
+            return 0;
+        } else if (paquet.opcode == OPCODE_ERROR) {
+            // Le client refuse les options proposées
+            compter_erreur_recue(paquet.code_erreur);
+            journaliser(NIVEAU_ERREUR, session_courante, EV_ERREUR_CLIENT, 0, "Options refusées par le client: %s", paquet.message.texte);
+            return -1;
+        }
+    }
+    journaliser(NIVEAU_ERREUR, session_courante, EV_ABANDON, 0, "Pas d'ACK pour l'OACK après %ld ms. Le client semble indisponible.", rtt->attente / 1000);
+    return -1;
+}
+
+// Fonction pour écrire dans les options la valeur multicast de l'OACK d'un membre du groupe
+void valeur_multicast(struct options_tftp *options, const struct groupe_multicast *g, int maitre) {
+    char adresse[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &g->addr_groupe.sin_addr, adresse, sizeof(adresse));
+    snprintf(options->multicast, sizeof(options->multicast), "%s,%d,%d", adresse, ntohs(g->addr_groupe.sin_port), maitre);
+}
+
+// Fonction pour créer le groupe multicast servi par une session RRQ, son client en étant le premier maître
+struct groupe_multicast *creer_groupe(const char *nom_fichier, struct options_tftp *options, int sockfd, const struct sockaddr_in *addr_client) {
+    struct groupe_multicast *g = malloc(sizeof(struct groupe_multicast));
+    if (g == NULL) {
+        erreur("Erreur lors de l'allocation d'un groupe multicast");
+    }
+    snprintf(g->nom_fichier, sizeof(g->nom_fichier), "%s", nom_fichier);
+    g->blksize = options->blksize;
+    g->windowsize = options->windowsize;
+    g->sockfd = sockfd;
+    g->membres[0] = *addr_client;
+    g->nb_membres = 1;
+    g->nb_clients = 1;
+    pthread_mutex_lock(&mutex_groupes);
+    // Chaque groupe a son port, les clients d'un groupe ne reçoivent pas les paquets des autres
+    g->addr_groupe = addr_multicast;
+    g->addr_groupe.sin_port = htons(prochain_port_multicast);
+    prochain_port_multicast = prochain_port_multicast == 65535 ? ntohs(addr_multicast.sin_port) : prochain_port_multicast + 1;
+    g->suivant = groupes;
+    groupes = g;
+    pthread_mutex_unlock(&mutex_groupes);
+    valeur_multicast(options, g, 1);
+    return g;
+}
+
+// Fonction pour inscrire un client dans le groupe en cours pour ce fichier, renvoie -1 s'il n'y en a aucun de compatible
+int rejoindre_groupe(struct sockaddr_in *addr_client, const char *nom_fichier, struct options_tftp *options) {
+    pthread_mutex_lock(&mutex_groupes);
+    // Le serveur peut proposer une taille de bloc ou de fenêtre inférieure à celle demandée, jamais supérieure
+    struct groupe_multicast *g = groupes;
+    while (g != NULL && (strcmp(g->nom_fichier, nom_fichier) != 0 || g->nb_membres == MAX_MEMBRES_GROUPE ||
+                         (options->blksize_negocie ? options->blksize < g->blksize : g->blksize != BLKSIZE_DEFAUT) ||
+                         (options->windowsize_negocie ? options->windowsize < g->windowsize : g->windowsize != 1))) {
+        g = g->suivant;
+    }
+    if (g == NULL) {
+        pthread_mutex_unlock(&mutex_groupes);
+        return -1;
+    }
+    int deja_membre = 0;
+    for (int i = 0; i < g->nb_membres; i++) {
+        deja_membre |= meme_client(&g->membres[i], addr_client);
+    }
+    if (!deja_membre) {
+        // Une RRQ renvoyée parce que l'OACK a été perdu ne réinscrit pas le client
+        g->membres[g->nb_membres++] = *addr_client;
+        g->nb_clients++;
+    }
+    options->blksize = g->blksize;
+    options->windowsize = g->windowsize;
+    struct stat infos;
+    if (stat(nom_fichier, &infos) == 0) {
+        options->tsize = infos.st_size;
+    }
+    valeur_multicast(options, g, 0);
+    char oack[TAILLE_PAQUET];
+    int taille_oack = construire_oack(oack, options);
+    // L'OACK part du TID du groupe, tenu ouvert tant que le groupe est dans la table
+    sendto(g->sockfd, oack, taille_oack, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in));
+    int nb_membres = g->nb_membres;
+    pthread_mutex_unlock(&mutex_groupes);
+    journaliser(NIVEAU_INFO, session_courante, EV_GROUPE, 0, "Client ajouté au groupe multicast du fichier '%s' (%d membres)", nom_fichier, nb_membres);
+    return 0;
+}
+
+// Fonction pour retirer un client du groupe, renvoie le nombre de membres restants
+// Un groupe vide est retiré de la table : plus aucun client ne peut le rejoindre
+int retirer_membre(struct groupe_multicast *g, const struct sockaddr_in *addr_client) {
+    pthread_mutex_lock(&mutex_groupes);
+    for (int i = 0; i < g->nb_membres; i++) {
+        if (meme_client(&g->membres[i], addr_client)) {
+            memmove(&g->membres[i], &g->membres[i + 1], (g->nb_membres - i - 1) * sizeof(struct sockaddr_in));
+            g->nb_membres--;
+            break;
+        }
+    }
+    int restants = g->nb_membres;
+    if (restants == 0) {
+        struct groupe_multicast **courant = &groupes;
+        while (*courant != g) {
+            courant = &(*courant)->suivant;
+        }
+        *courant = g->suivant;
+    }
+    pthread_mutex_unlock(&mutex_groupes);
+    return restants;
+}
+
+// Fonction pour désigner un client comme maître du groupe par un OACK ",,1"
+void envoyer_promotion(int sockfd, struct sockaddr_in *maitre) {
+    char oack[TAILLE_PAQUET];
+    int taille_oack = 2;
+    oack[0] = 0;
+    oack[1] = OPCODE_OACK;
+    taille_oack += sprintf(oack + taille_oack, "multicast") + 1;
+    taille_oack += sprintf(oack + taille_oack, ",,1") + 1;
+    sendto(sockfd, oack, taille_oack, 0, (struct sockaddr *)maitre, sizeof(struct sockaddr_in));
+}
 
-        unsigned char opcode = buffer[1];
-        if (opcode == OPCODE_DATA) {
-            // Réception du paquet de données
-            numero_bloc++;
-            pthread_mutex_lock(&fichier_mutex); // Verrouiller le mutex avant d'accéder au fichier
-            fwrite(buffer + 4, 1, bytes_recus - 4, fichier); // Écriture des données dans le fichier
-            pthread_mutex_unlock(&fichier_mutex); // Déverrouiller le mutex après avoir accédé au fichier
+// Fonction pour retirer le maître du groupe et promouvoir le membre suivant, renvoie 0 si le groupe est vide
+int changer_maitre(struct groupe_multicast *g, struct sockaddr_in *maitre) {
+    if (retirer_membre(g, maitre) == 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&mutex_groupes);
+    *maitre = g->membres[0];
+    pthread_mutex_unlock(&mutex_groupes);
+    envoyer_promotion(g->sockfd, maitre);
+    return 1;
+}
 
-            // Envoi de l'ACK
-            ack_packet.block_num = htons(numero_bloc);
+// Fonction exécutée par le thread d'E/S d'une WRQ : écrit les tampons pleins à la suite dans le fichier
+void *thread_ecriture(void *arg) {
+    struct pipeline_ecriture *p = (struct pipeline_ecriture *)arg;
+    pthread_mutex_lock(&p->verrou);
+    while (1) {
+        while (!p->a_ecrire && !p->fin) {
+            pthread_cond_wait(&p->condition, &p->verrou);
+        }
+        if (!p->a_ecrire) {
+            break;
+        }
+        const char *donnees = p->tampons[p->tampon_a_ecrire];
+        size_t taille = p->taille_a_ecrire;
+        off_t position = p->position;
+        int erreur_ecriture = p->erreur;
+        pthread_mutex_unlock(&p->verrou);
 
-            if (sendto(sockfd, &ack_packet, sizeof(ack_packet), 0, (struct sockaddr *)addr_client, longueur_client) < 0) {
-                erreur("Erreur lors de l'envoi de l'ACK pour DATA");
+        // Écriture hors verrou : la réception continue de remplir l'autre tampon
+        size_t ecrits = 0;
+        while (erreur_ecriture == 0 && ecrits < taille) {
+            ssize_t n = pwrite(p->fd, donnees + ecrits, taille - ecrits, position + ecrits);
+            if (n < 0 && errno != EINTR) {
+                erreur_ecriture = errno;
+            } else if (n > 0) {
+                ecrits += n;
             }
+            p->nb_ecritures++;
+        }
+        p->depuis_sync += ecrits;
+        if (erreur_ecriture == 0 && mode_durabilite == DURABILITE_PERIODIQUE && p->depuis_sync >= intervalle_sync) {
+            if (fdatasync(p->fd) < 0) {
+                erreur_ecriture = errno;
+            }
+            p->depuis_sync = 0;
+        }
 
-            if (bytes_recus < TAILLE_PAQUET) {
-                // Dernier paquet de données
-                break;
+        pthread_mutex_lock(&p->verrou);
+        p->erreur = erreur_ecriture;
+        p->position += ecrits;
+        p->a_ecrire = 0;
+        pthread_cond_broadcast(&p->condition);
+    }
+    pthread_mutex_unlock(&p->verrou);
+
+    // Synchronisation finale avant la publication du fichier
+    if (p->erreur == 0 && mode_durabilite != DURABILITE_AUCUNE && fdatasync(p->fd) < 0) {
+        p->erreur = errno;
+    }
+    return NULL;
+}
+
+// Fonction pour démarrer le pipeline d'écriture d'une WRQ, en réservant la taille annoncée par tsize
+int demarrer_pipeline(struct pipeline_ecriture *p, int fd, long long taille_prevue) {
+    memset(p, 0, sizeof(*p));
+    p->fd = fd;
+    // Réservation sans changer la taille du fichier : une taille annoncée fausse ne laisse pas de zéros à la fin
+    if (taille_prevue > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, taille_prevue) < 0 && errno == ENOSPC) {
+        return -1;
+    }
+    // Tampons alignés sur la page, écrits à des positions multiples de leur taille
+    for (int i = 0; i < 2; i++) {
+        if (posix_memalign((void **)&p->tampons[i], ALIGNEMENT_ECRITURE, TAILLE_TAMPON_ECRITURE) != 0) {
+            erreur("Erreur lors de l'allocation des tampons d'écriture");
+        }
+    }
+    pthread_mutex_init(&p->verrou, NULL);
+    pthread_cond_init(&p->condition, NULL);
+    pthread_attr_t attributs;
+    pthread_attr_init(&attributs);
+    pthread_attr_setstacksize(&attributs, TAILLE_PILE_TRAVAILLEUR);
+    if (pthread_create(&p->thread, &attributs, thread_ecriture, p) != 0) {
+        erreur("Erreur lors de la création du thread d'écriture");
+    }
+    pthread_attr_destroy(&attributs);
+    return 0;
+}
+
+// Fonction pour confier le tampon courant au thread d'E/S, retourne -1 si une écriture précédente a échoué
+int confier_tampon(struct pipeline_ecriture *p) {
+    pthread_mutex_lock(&p->verrou);
+    // Le disque est plus lent que le réseau : on attend que l'autre tampon soit libéré
+    while (p->a_ecrire) {
+        pthread_cond_wait(&p->condition, &p->verrou);
+    }
+    int erreur_ecriture = p->erreur;
+    if (erreur_ecriture == 0) {
+        p->tampon_a_ecrire = p->courant;
+        p->taille_a_ecrire = p->remplissage;
+        p->a_ecrire = 1;
+        pthread_cond_broadcast(&p->condition);
+    }
+    pthread_mutex_unlock(&p->verrou);
+    if (erreur_ecriture != 0) {
+        errno = erreur_ecriture;
+        return -1;
+    }
+    p->courant = 1 - p->courant;
+    p->remplissage = 0;
+    return 0;
+}
+
+// Fonction pour ajouter les données d'un bloc au pipeline, retourne -1 si l'écriture a échoué
+int ecrire_pipeline(struct pipeline_ecriture *p, const char *donnees, size_t taille) {
+    while (taille > 0) {
+        size_t place = TAILLE_TAMPON_ECRITURE - p->remplissage;
+        size_t copie = taille < place ? taille : place;
+        memcpy(p->tampons[p->courant] + p->remplissage, donnees, copie);
+        p->remplissage += copie;
+        donnees += copie;
+        taille -= copie;
+        if (p->remplissage == TAILLE_TAMPON_ECRITURE && confier_tampon(p) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fonction pour vider le pipeline et arrêter son thread d'E/S, retourne -1 si une écriture a échoué
+int terminer_pipeline(struct pipeline_ecriture *p) {
+    if (p->remplissage > 0) {
+        confier_tampon(p);
+    }
+    pthread_mutex_lock(&p->verrou);
+    p->fin = 1;
+    pthread_cond_broadcast(&p->condition);
+    pthread_mutex_unlock(&p->verrou);
+    pthread_join(p->thread, NULL);
+    pthread_mutex_destroy(&p->verrou);
+    pthread_cond_destroy(&p->condition);
+    free(p->tampons[0]);
+    free(p->tampons[1]);
+    if (p->erreur != 0) {
+        errno = p->erreur;
+        return -1;
+    }
+    // Libération de l'espace réservé au-delà de la taille réelle si tsize était surestimé : sans elle, le fichier
+    // publié garderait un bourrage après les octets reçus (errno est positionné par ftruncate)
+    if (ftruncate(p->fd, p->position) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Fonction pour recevoir une demande d'écriture (WRQ) du client avec timeout
+int recevoir_wrq(struct sockaddr_in *addr_client, const char *nom_fichier, const char *mode, const struct options_tftp *options) {
+    journaliser(NIVEAU_INFO, session_courante, EV_REQUETE, 0, "Requête d'écriture (WRQ) reçue pour le fichier '%s'", nom_fichier);
+    int taille_paquet = options->blksize + 4; // Taille d'un paquet DATA complet
+    char *buffer;
+    char oack[TAILLE_PAQUET];
+    struct sockaddr_in addr_source;
+    socklen_t longueur_source;
+    struct fenetre_reception reception;
+    struct estimateur_rtt rtt;
+    long instant_ack = 0;  // Envoi du dernier ACK de fin de fenêtre, 0 si aucune mesure de RTT n'est en cours
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        erreur("Erreur lors de la création du socket");
+    }
+    initialiser_rtt(&rtt, options->timeout);
+    initialiser_reception(&reception, options);
+
+    // Écriture dans un fichier temporaire du même répertoire, renommé à la réception du dernier bloc
+    // pour que les lecteurs voient toujours soit l'ancienne soit la nouvelle version complète
+    char chemin_temporaire[TAILLE_PAQUET + 16];
+    snprintf(chemin_temporaire, sizeof(chemin_temporaire), "%s.XXXXXX", nom_fichier);
+    int fd_temporaire = mkstemp(chemin_temporaire);
+    if (fd_temporaire < 0) {
+        envoyer_erreur(sockfd, addr_client, 2, "Impossible de créer le fichier.");
+        close(sockfd);
+        return -1;
+    }
+    fchmod(fd_temporaire, 0644);
+
+    // Les blocs reçus sont regroupés en grandes écritures faites par un thread d'E/S dédié
+    struct pipeline_ecriture pipeline;
+    if (demarrer_pipeline(&pipeline, fd_temporaire, options->tsize) < 0) {
+        envoyer_erreur(sockfd, addr_client, 3, "Espace disque insuffisant.");
+        close(fd_temporaire);
+        unlink(chemin_temporaire);
+        close(sockfd);
+        return -1;
+    }
+
+    // Tampon de réception alloué avec la taille de bloc négociée
+    buffer = malloc(taille_paquet);
+    if (buffer == NULL) {
+        erreur("Erreur lors de l'allocation du tampon de réception");
+    }
+    dimensionner_tampons(sockfd, options);
+
+    // Envoi de l'OACK si des options ont été négociées, sinon de l'ACK pour WRQ
+    int taille_oack = construire_oack(oack, options);
+    if (taille_oack > 0) {
+        sendto(sockfd, oack, taille_oack, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in));
+    } else {
+        envoyer_ack(sockfd, addr_client, 0);
+    }
+    instant_ack = maintenant_us();
+    armer_rtt(&rtt);
+
+    while (1) {
+        appliquer_rto(sockfd, &rtt);
+        longueur_source = sizeof(addr_source);
+        int bytes_recus = recvfrom(sockfd, buffer, taille_paquet, 0, (struct sockaddr *)&addr_source, &longueur_source);
+        if (bytes_recus < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                erreur("Erreur de réception des données");
+            }
+            if (expiration_rtt(&rtt)) {
+                journaliser(NIVEAU_ERREUR, session_courante, EV_ABANDON, reception.numero_bloc, "Échec de la réception des données après %ld ms d'attente. Le client semble indisponible.", rtt.attente / 1000);
+                close(sockfd);
+                terminer_pipeline(&pipeline);
+                close(fd_temporaire);
+                unlink(chemin_temporaire);
+                free(buffer);
+                return -1;
+            }
+            // Timeout : renvoi du dernier acquittement pour relancer le client
+            compter(&compteurs()->retransmissions, 1);
+            journaliser_bloc(session_courante, EV_EXPIRATION, reception.numero_bloc, rtt.rto);
+            if (reception.numero_bloc == 0 && taille_oack > 0) {
+                sendto(sockfd, oack, taille_oack, 0, (struct sockaddr *)addr_client, sizeof(struct sockaddr_in));
+            } else {
+                envoyer_ack(sockfd, addr_client, bloc_sur_fil(reception.numero_bloc, options->rollover));
             }
-        } else if (opcode == OPCODE_ERROR) {
+            reception.recus_fenetre = 0;
+            instant_ack = 0; // Un ACK renvoyé rendrait la mesure ambiguë (règle de Karn)
+            armer_rtt(&rtt);
+            continue;
+        }
+        struct paquet_decode paquet;
+        if (!meme_client(&addr_source, addr_client) || decoder_paquet(buffer, bytes_recus, &paquet) < 0) {
+            continue;
+        }
+
+        if (paquet.opcode == OPCODE_DATA) {
+            int classement = recevoir_bloc(&reception, paquet.bloc);
+            if (classement == BLOC_SUIVANT) {
+                // Réception du paquet de données attendu
+                compter(&compteurs()->blocs_recus, 1);
+                compter(&compteurs()->octets_recus, paquet.taille_donnees);
+                journaliser_bloc(session_courante, EV_BLOC_RECU, reception.numero_bloc, paquet.taille_donnees);
+                progression_rtt(&rtt);
+                armer_rtt(&rtt);
+                if (instant_ack != 0) {
+                    // Premier bloc de la fenêtre suivante : un aller-retour depuis l'ACK
+                    mesurer_rtt(&rtt, maintenant_us() - instant_ack);
+                    instant_ack = 0;
+                }
+                if (ecrire_pipeline(&pipeline, paquet.donnees, paquet.taille_donnees) < 0) {
+                    // Écriture impossible (disque plein...) : le client est prévenu au lieu d'attendre la fin
+                    journaliser(NIVEAU_ERREUR, session_courante, EV_ERREUR, reception.numero_bloc, "Erreur lors de l'écriture du fichier reçu: %s", strerror(errno));
+                    envoyer_erreur(sockfd, addr_client, 3, errno == ENOSPC ? "Espace disque insuffisant." : "Erreur lors de l'écriture du fichier.");
+                    close(sockfd);
+                    terminer_pipeline(&pipeline);
+                    close(fd_temporaire);
+                    unlink(chemin_temporaire);
+                    free(buffer);
+                    return -1;
+                }
+
+                if (bytes_recus < taille_paquet) {
+                    // Dernier paquet de données, acquitté une fois le fichier publié
+                    break;
+                }
+                // Acquittement cumulatif à la fin de chaque fenêtre
+                if (fenetre_complete(&reception)) {
+                    envoyer_ack(sockfd, addr_client, bloc_sur_fil(reception.numero_bloc, options->rollover));
+                    instant_ack = maintenant_us();
+                }
+            } else if (classement == BLOC_HORS_SEQUENCE) {
+                // Doublon ou bloc hors séquence : acquitter le dernier bloc reçu dans l'ordre, sans réarmer le délai
+                journaliser_bloc(session_courante, EV_HORS_SEQUENCE, paquet.bloc, reception.numero_bloc);
+                envoyer_ack(sockfd, addr_client, bloc_sur_fil(reception.numero_bloc, options->rollover));
+                instant_ack = 0;
+            }
+        } else if (paquet.opcode == OPCODE_ERROR) {
             // Erreur reçue du client
-            fprintf(stderr, "Erreur du client: %s\n", buffer + 4);
-            fclose(fichier);
-            remove(nom_fichier); // Supprimer le fichier en cas d'erreur
+            compter_erreur_recue(paquet.code_erreur);
+            journaliser(NIVEAU_ERREUR, session_courante, EV_ERREUR_CLIENT, reception.numero_bloc, "Erreur du client: %s", paquet.message.texte);
+            close(sockfd);
+            terminer_pipeline(&pipeline);
+            close(fd_temporaire);
+            free(buffer);
+            unlink(chemin_temporaire); // Supprimer le fichier temporaire en cas d'erreur
             return -1;
         }
     }
+    free(buffer);
+
+    // Publication atomique du fichier reçu, une fois toutes les écritures (et la synchronisation) terminées
+    int resultat = terminer_pipeline(&pipeline);
+    if (close(fd_temporaire) != 0) {
+        resultat = -1;
+    }
+    if (resultat < 0 || publier_fichier(chemin_temporaire, nom_fichier) < 0) {
+        journaliser(NIVEAU_ERREUR, session_courante, EV_ERREUR, reception.numero_bloc, "Erreur lors de l'enregistrement du fichier reçu: %s", strerror(errno));
+        unlink(chemin_temporaire);
+        envoyer_erreur(sockfd, addr_client, 3, "Erreur lors de l'enregistrement du fichier.");
+        close(sockfd);
+        return -1;
+    }
+    invalider_cache(nom_fichier);
+    envoyer_ack(sockfd, addr_client, bloc_sur_fil(reception.numero_bloc, options->rollover));
     close(sockfd);
-    fclose(fichier);
-    printf("Fin de la réception du fichier du fichier '%s'\n", nom_fichier);
+    journaliser(NIVEAU_INFO, session_courante, EV_FIN, reception.numero_bloc, "Fin de la réception du fichier '%s' (%ld écritures pour %lld octets)", nom_fichier, pipeline.nb_ecritures, (long long)pipeline.position);
     return 0;
 }
 
 // Fonction pour recevoir une demande de lecture (RRQ) du client avec timeout
-int recevoir_rrq(struct sockaddr_in *addr_client, const char *nom_fichier, const char *mode) {
-    printf("Requête de lecture (RRQ) reçue pour le fichier '%s'\n", nom_fichier);
-    char buffer[TAILLE_PAQUET];
-    socklen_t longueur_client = sizeof(struct sockaddr_in);
-    FILE *fichier;
-    pthread_mutex_lock(&fichier_mutex); // Verrouiller le mutex avant d'accéder au fichier
-    fichier = fopen(nom_fichier, "rb"); // Ouverture en mode lecture binaire
-    pthread_mutex_unlock(&fichier_mutex); // Déverrouiller le mutex après avoir accédé au fichier
-    int numero_bloc = 1;
+int recevoir_rrq(struct sockaddr_in *addr_client, const char *nom_fichier, const char *mode, struct options_tftp *options) {
+    journaliser(NIVEAU_INFO, session_courante, EV_REQUETE, 0, "Requête de lecture (RRQ) reçue pour le fichier '%s'", nom_fichier);
+    FILE *fichier = fopen(nom_fichier, "rb"); // Ouverture en mode lecture binaire
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         erreur("Erreur lors de la création du socket");
     }
+    struct estimateur_rtt rtt;
+    initialiser_rtt(&rtt, options->timeout);
     if (fichier == NULL) {
         // Fichier introuvable, envoi du paquet d'erreur
-        buffer[0] = 0;
-        buffer[1] = OPCODE_ERROR;
-        buffer[2] = 0;
-        buffer[3] = 1; // Code d'erreur pour fichier non trouvé
-        strcpy(buffer + 4, "Fichier non trouvé.");
-        sendto(sockfd, buffer, strlen("Fichier non trouvé.") + 5, 0, (struct sockaddr *)addr_client, longueur_client);
+        envoyer_erreur(sockfd, addr_client, 1, "Fichier non trouvé.");
+        close(sockfd);
         return -1;
     }
 
-    // Envoi du premier paquet de données
+    // Verrou partagé du fichier : les lecteurs d'un même fichier ne se bloquent jamais entre eux
+    struct stat infos;
+    fstat(fileno(fichier), &infos);
+    struct verrou_fichier *verrou = acquerir_verrou_fichier(infos.st_dev, infos.st_ino);
+    options->tsize = infos.st_size; // Taille renvoyée dans l'OACK si le client a demandé tsize
+
+    // Groupe multicast seulement si les numéros de bloc ne se replient pas : un client arrivé en cours de
+    // transfert doit pouvoir situer chaque bloc reçu dans le fichier
+    struct groupe_multicast *groupe = NULL;
+    long nb_blocs = infos.st_size / options->blksize + 1;
+    if (options->multicast_negocie && nb_blocs <= 65535) {
+        groupe = creer_groupe(nom_fichier, options, sockfd, addr_client);
+    } else {
+        options->multicast_negocie = 0;
+    }
+    struct sockaddr_in maitre = *addr_client; // Client dont les ACK pilotent l'envoi : le demandeur ou le maître du groupe
+    int attente_maitre = 0;                   // Groupe : 1 tant que le nouveau maître n'a pas indiqué où reprendre
+
+    // Négociation des options avant le premier paquet de données
+    if (options_negociees(options) && negocier_oack(sockfd, addr_client, options, &rtt) < 0) {
+        if (groupe == NULL || !changer_maitre(groupe, &maitre)) {
+            close(sockfd);
+            fclose(fichier);
+            liberer_verrou_fichier(verrou);
+            free(groupe);
+            return -1;
+        }
+        // Les autres membres du groupe ne dépendent pas du premier client
+        attente_maitre = 1;
+        progression_rtt(&rtt);
+        armer_rtt(&rtt);
+    }
+
+    // Fichier servi depuis sa projection mmap ou le cache partagé si possible, sinon lu bloc par bloc
+    struct entree_cache *entree = NULL;
+    const char *contenu = NULL;
+    off_t taille_contenu = 0;
+    if (mode_mmap) {
+        contenu = projeter_fichier(verrou, fileno(fichier), infos.st_size);
+        taille_contenu = verrou->taille_projection < infos.st_size ? verrou->taille_projection : infos.st_size;
+    } else {
+        entree = obtenir_entree_cache(nom_fichier, fichier, &infos);
+        if (entree != NULL) {
+            contenu = entree->contenu;
+            taille_contenu = entree->taille;
+        }
+    }
+
+    // Lots d'envoi et de réception : une fenêtre part en un appel sendmmsg, les ACK sont vidés par recvmmsg
+    struct lot_envoi lot;
+    lot.nb_paquets = 0;
+    lot.nb_appels = 0;
+    lot.total_paquets = 0;
+    lot.nb_envois_gso = 0;
+    // Le GSO n'a d'intérêt que si plusieurs paquets complets tiennent dans un envoi
+    lot.taille_segment = mode_gso && 2 * (options->blksize + 4) <= TAILLE_GSO_MAX ? options->blksize + 4 : 0;
+    struct lot_reception *acks = malloc(sizeof(struct lot_reception));
+    // Sans fichier en mémoire, chaque bloc de la fenêtre doit rester lisible jusqu'à l'envoi du lot
+    char *tampons = NULL;
+    if (contenu == NULL) {
+        tampons = malloc((size_t)options->windowsize * options->blksize);
+    }
+    if (acks == NULL || (contenu == NULL && tampons == NULL)) {
+        erreur("Erreur lors de l'allocation des tampons de la session");
+    }
+    initialiser_lot_reception(acks);
+    dimensionner_tampons(sockfd, options);
+    // Le contrôle de congestion suit un seul destinataire : il ne s'applique pas aux groupes multicast
+    struct controle_congestion congestion;
+    initialiser_congestion(&congestion, groupe != NULL ? CONGESTION_AUCUN : mode_congestion, options->windowsize);
+    if (congestion.mode != CONGESTION_AUCUN && options->windowsize <= CWND_MIN) {
+        // La fenêtre de congestion ne descend pas sous CWND_MIN : une fenêtre négociée aussi petite n'est jamais rythmée
+        journaliser(NIVEAU_INFO, session_courante, EV_CONGESTION, 0, "Contrôle de congestion %s sans effet avec windowsize %d (minimum rythmé : %d)",
+                    noms_congestion[congestion.mode], options->windowsize, (int)CWND_MIN + 1);
+    }
+    struct regulation regulation;
+    struct regulation *regule = NULL;
+    if (limiteur_actif || congestion.mode != CONGESTION_AUCUN) {
+        initialiser_regulation(&regulation, addr_client);
+        regule = &regulation;
+    }
+
+    struct fenetre_envoi envoi;
+    initialiser_envoi(&envoi, options);
+    long bloc_fichier = 1;  // Bloc correspondant à la position courante dans le fichier
+    int resultat = 0;
+    // Les paquets DATA d'un groupe partent vers l'adresse multicast, dont le dernier bloc est connu d'avance
+    struct sockaddr_in *destination = addr_client;
+    if (groupe != NULL) {
+        destination = &groupe->addr_groupe;
+        envoi.dernier_bloc = nb_blocs;
+    }
+
     while (1) {
-        struct tftp_data_packet data_packet;
-        data_packet.opcode = htons(OPCODE_DATA);
-        data_packet.block_num = htons(numero_bloc);
-
-        int bytes_lus;
-        pthread_mutex_lock(&fichier_mutex); // Verrouiller le mutex avant d'accéder au fichier
-        bytes_lus = fread(data_packet.data, 1, TAILLE_PAQUET - 4, fichier);
-        pthread_mutex_unlock(&fichier_mutex); // Déverrouiller le mutex après avoir accédé au fichier
-        if (bytes_lus < TAILLE_PAQUET - 4) {
-            // Dernier paquet de données
-            sendto(sockfd, &data_packet, bytes_lus + 4, 0, (struct sockaddr *)addr_client, longueur_client);
-            break;
-        } else {
-            sendto(sockfd, &data_packet, TAILLE_PAQUET, 0, (struct sockaddr *)addr_client, longueur_client);
+        if (!attente_maitre && envoi.dernier_bloc != 0 && envoi.dernier_ack >= envoi.dernier_bloc) {
+            // Fichier acquitté par le client, ou par le maître du groupe : au tour du membre suivant
+            if (groupe == NULL || !changer_maitre(groupe, &maitre)) {
+                break;
+            }
+            attente_maitre = 1;
+            progression_rtt(&rtt);
+            armer_rtt(&rtt);
         }
 
-        // Attendre l'ACK du client avec timeout
-        int tentatives = 0;
-        while (tentatives < MAX_TENTATIVES) {
-            int bytes_recus = recvfrom(sockfd, buffer, TAILLE_PAQUET, 0, (struct sockaddr *)addr_client, &longueur_client);
-            if (bytes_recus < 0) {
-                perror("Erreur de réception des données");
-                tentatives++;
-                sleep(TIMEOUT_SEC);
+        // Préparation de tous les blocs de la fenêtre courante, envoyés ensuite sans attendre d'ACK
+        long premier_envoye = envoi.prochain_bloc;
+        long octets_fenetre = 0;
+        // Rien n'est envoyé au groupe avant l'ACK du nouveau maître
+        if (contenu == NULL && !attente_maitre) {
+            pthread_rwlock_rdlock(&verrou->verrou); // Verrou partagé le temps de la lecture de la fenêtre
+        }
+        while (!attente_maitre && bloc_a_envoyer(&envoi)) {
+            int bytes_lus;
+            if (contenu != NULL) {
+                off_t debut = (off_t)(envoi.prochain_bloc - 1) * options->blksize;
+                bytes_lus = 0;
+                if (debut < taille_contenu) {
+                    bytes_lus = taille_contenu - debut < options->blksize ? (int)(taille_contenu - debut) : options->blksize;
+                }
+                ajouter_au_lot(&lot, destination, bloc_sur_fil(envoi.prochain_bloc, options->rollover), contenu + debut, bytes_lus);
             } else {
-                if (buffer[1] == OPCODE_ACK) {
-                    unsigned short ack_block_num = ntohs(*(unsigned short *)(buffer + 2));
-                    if (ack_block_num == numero_bloc) {
-                        break;
-                    }
+                if (bloc_fichier != envoi.prochain_bloc) {
+                    // Retour en arrière après une perte : repositionnement dans le fichier
+                    fseeko(fichier, (off_t)(envoi.prochain_bloc - 1) * options->blksize, SEEK_SET);
+                    bloc_fichier = envoi.prochain_bloc;
                 }
+                char *donnees = tampons + (size_t)lot.nb_paquets * options->blksize;
+                bytes_lus = fread(donnees, 1, options->blksize, fichier);
+                bloc_fichier++;
+                ajouter_au_lot(&lot, destination, bloc_sur_fil(envoi.prochain_bloc, options->rollover), donnees, bytes_lus);
             }
+            if (bytes_lus < options->blksize) {
+                // Dernier paquet de données
+                envoi.dernier_bloc = envoi.prochain_bloc;
+            }
+            octets_fenetre += bytes_lus;
+            envoi.prochain_bloc++;
         }
-        if (tentatives == MAX_TENTATIVES) {
-            fprintf(stderr, "Échec de la réception de l'ACK après %d tentatives. Le client semble indisponible.\n", MAX_TENTATIVES);
-            fclose(fichier);
-            return -1;
+        if (contenu == NULL && !attente_maitre) {
+            pthread_rwlock_unlock(&verrou->verrou);
+        }
+        // L'instant retenu pour la mesure du RTT est celui de la dernière tranche, qui porte le bloc mesuré
+        if (congestion.mode != CONGESTION_AUCUN) {
+            regulation.debit_rythme = debit_congestion(&congestion, &rtt, options->blksize + 4 + ENTETES_IP_UDP);
+        }
+        long instant = envoyer_lot(sockfd, &lot, regule, options->blksize);
+        long nb_retransmis = fenetre_envoyee(&envoi, premier_envoye, instant);
+        if (envoi.prochain_bloc > premier_envoye) {
+            compter_envoi(envoi.prochain_bloc - premier_envoye, nb_retransmis, octets_fenetre);
         }
-        numero_bloc++;
+        if (envoi.prochain_bloc > premier_envoye) {
+            journaliser_bloc(session_courante, EV_FENETRE, premier_envoye, envoi.prochain_bloc - premier_envoye);
+            // Seul un envoi réarme le délai : un ACK périmé, qui n'ouvre pas la fenêtre, ne retarde pas la retransmission
+            armer_rtt(&rtt);
+        }
+
+        // Attendre les ACK cumulatifs du client avec timeout, tous ceux déjà arrivés étant lus d'un coup
+        appliquer_rto(sockfd, &rtt);
+        int nb_recus = recevoir_lot(sockfd, acks);
+        if (nb_recus <= 0) {
+            if (expiration_rtt(&rtt)) {
+                journaliser(NIVEAU_ERREUR, session_courante, EV_ABANDON, envoi.dernier_ack, "Échec de la réception de l'ACK après %ld ms d'attente. Le client semble indisponible.", rtt.attente / 1000);
+                if (groupe != NULL && changer_maitre(groupe, &maitre)) {
+                    // Le groupe continue avec le membre suivant
+                    attente_maitre = 1;
+                    progression_rtt(&rtt);
+                    armer_rtt(&rtt);
+                    continue;
+                }
+                resultat = -1;
+                break;
+            }
+            if (attente_maitre) {
+                envoyer_promotion(sockfd, &maitre);
+                armer_rtt(&rtt);
+                continue;
+            }
+            // Timeout : retour au bloc qui suit le dernier ACK reçu
+            journaliser_bloc(session_courante, EV_EXPIRATION, envoi.dernier_ack + 1, rtt.rto);
+            if (congestion_perte(&congestion, &envoi, 1)) {
+                journaliser_bloc(session_courante, EV_CONGESTION, envoi.dernier_ack, (long)congestion.cwnd);
+            }
+            reprendre_envoi(&envoi, envoi.dernier_ack);
+            continue;
+        }
+
+        for (int i = 0; i < nb_recus && resultat == 0; i++) {
+            struct paquet_decode paquet;
+            if (decoder_paquet(acks->tampons[i], acks->messages[i].msg_len, &paquet) < 0) {
+                continue;
+            }
+            if (!meme_client(&acks->sources[i], &maitre)) {
+                // Un membre du groupe quitte le groupe par l'ACK du dernier bloc (fichier complet) ou par une erreur
+                if (groupe != NULL && ((paquet.opcode == OPCODE_ACK && paquet.bloc == nb_blocs) || paquet.opcode == OPCODE_ERROR)) {
+                    retirer_membre(groupe, &acks->sources[i]);
+                }
+                continue;
+            }
+            if (paquet.opcode == OPCODE_ACK && attente_maitre) {
+                // Premier ACK du nouveau maître : le bloc qui précède le premier qui lui manque
+                if (paquet.bloc <= nb_blocs) {
+                    reprendre_envoi(&envoi, paquet.bloc);
+                    attente_maitre = 0;
+                    progression_rtt(&rtt);
+                }
+            } else if (paquet.opcode == OPCODE_ACK) {
+                // Dans un groupe, le maître peut acquitter des blocs reçus avant sa promotion, au-delà de ceux envoyés depuis
+                long plafond = groupe != NULL ? envoi.dernier_bloc : envoi.prochain_bloc - 1;
+                long avance = accepter_ack(&envoi, paquet.bloc, plafond);
+                if (avance > 0) {
+                    journaliser_bloc(session_courante, EV_ACK, envoi.dernier_ack, avance);
+                    progression_rtt(&rtt);
+                    congestion_ack(&congestion, avance);
+                } else if (paquet.bloc == bloc_sur_fil(envoi.dernier_ack, options->rollover) &&
+                           congestion_perte(&congestion, &envoi, 0)) {
+                    // ACK en double : le bloc qui suit le dernier acquitté n'est pas arrivé, il sera renvoyé à l'expiration
+                    journaliser_bloc(session_courante, EV_CONGESTION, envoi.dernier_ack, (long)congestion.cwnd);
+                }
+            } else if (paquet.opcode == OPCODE_ERROR) {
+                compter_erreur_recue(paquet.code_erreur);
+                journaliser(NIVEAU_ERREUR, session_courante, EV_ERREUR_CLIENT, envoi.dernier_ack, "Erreur du client: %s", paquet.message.texte);
+                if (groupe != NULL && changer_maitre(groupe, &maitre)) {
+                    attente_maitre = 1;
+                    progression_rtt(&rtt);
+                    armer_rtt(&rtt);
+                    break;
+                }
+                resultat = -1;
+            }
+        }
+        if (resultat < 0) {
+            break;
+        }
+        // ACK partiel : le client a détecté un trou, on reprend après le dernier bloc acquitté
+        long a_renvoyer = conclure_acks(&envoi, &rtt);
+        if (a_renvoyer > 0) {
+            journaliser_bloc(session_courante, EV_RETRANSMISSION, envoi.dernier_ack + 1, a_renvoyer);
+            if (congestion_perte(&congestion, &envoi, 0)) {
+                journaliser_bloc(session_courante, EV_CONGESTION, envoi.dernier_ack, (long)congestion.cwnd);
+            }
+        }
+        congestion_delai(&congestion, &rtt);
     }
 
+    close(sockfd);
     fclose(fichier);
-    printf("Fin de l'envoi du fichier '%s'\n", nom_fichier);
-    return 0;
+    liberer_verrou_fichier(verrou);
+    if (regule != NULL) {
+        liberer_regulation(regule);
+    }
+    if (entree != NULL) {
+        liberer_entree_cache(entree);
+    }
+    if (groupe != NULL) {
+        journaliser(NIVEAU_INFO, session_courante, EV_GROUPE, envoi.dernier_ack, "Fin du groupe multicast du fichier '%s' (%d clients)", nom_fichier, groupe->nb_clients);
+        free(groupe);
+    }
+    if (resultat == 0) {
+        journaliser(NIVEAU_INFO, session_courante, EV_FIN, envoi.dernier_ack, "Fin de l'envoi du fichier '%s' (%ld paquets en %ld sendmmsg, %.1f par lot ; %ld ACK en %ld recvmmsg, %.1f par lot ; %ld envois GSO ; RTT lissé %ld us, RTO %ld us ; fenêtre de congestion %.1f)",
+               nom_fichier, lot.total_paquets, lot.nb_appels, lot.nb_appels ? (double)lot.total_paquets / lot.nb_appels : 0.0,
+               acks->total_paquets, acks->nb_appels, acks->nb_appels ? (double)acks->total_paquets / acks->nb_appels : 0.0,
+               lot.nb_envois_gso, rtt.srtt, rtt.rto, congestion.cwnd);
+    }
+    free(tampons);
+    free(acks);
+    return resultat;
 }
 
-// Fonction pour traiter une requête dans un thread
-void* process_request(void* arg) {
-    // Récupérer les arguments
-    struct thread_data *data = (struct thread_data *)arg;
-    socklen_t longueur_client = sizeof(struct sockaddr_in);
+// Fonction pour traiter une requête dans un thread de travail
+void traiter_requete(struct thread_data *data) {
+    struct paquet_decode requete;
+    struct options_tftp options;
+    session_courante = __atomic_add_fetch(&prochaine_session_journal, 1, __ATOMIC_RELAXED);
 
-    if (data->requete.opcode == htons(OPCODE_WRQ)) {
-        // Requête d'écriture (WRQ) reçue
-        recevoir_wrq(&data->addr_client, data->requete.filename, "Octet");
-    } else if (data->requete.opcode == htons(OPCODE_RRQ)) {
-        // Requête de lecture (RRQ) reçue
-        recevoir_rrq(&data->addr_client, data->requete.filename, "Octet");
+    // Analyse du nom de fichier, du mode et des options de la requête
+    if (decoder_paquet(data->requete, data->taille_requete, &requete) < 0) {
+        journaliser(NIVEAU_ERREUR, session_courante, EV_REQUETE_INVALIDE, 0, "Requête mal formée");
+        return;
+    }
+    analyser_requete(&requete, &options);
+    const char *nom_fichier = requete.nom_fichier.texte;
+    const char *mode = requete.mode.texte;
+    // L'option multicast n'est acquittée que si un groupe peut être proposé (option -M)
+    options.multicast_negocie = options.multicast_negocie && addr_multicast.sin_port != 0;
+
+    if (requete.opcode == OPCODE_WRQ) {
+        // Requête d'écriture (WRQ) reçue, l'option multicast ne concerne que les lectures
+        options.multicast_negocie = 0;
+        compter(&compteurs()->sessions_ouvertes, 1);
+        recevoir_wrq(&data->addr_client, nom_fichier, mode, &options);
+        compter(&compteurs()->sessions_fermees, 1);
+    } else if (requete.opcode == OPCODE_RRQ) {
+        // Requête de lecture (RRQ) reçue : un client multicast rejoint le groupe en cours pour ce fichier s'il y en a un
+        if (options.multicast_negocie && rejoindre_groupe(&data->addr_client, nom_fichier, &options) == 0) {
+            return;
+        }
+        compter(&compteurs()->sessions_ouvertes, 1);
+        recevoir_rrq(&data->addr_client, nom_fichier, mode, &options);
+        compter(&compteurs()->sessions_fermees, 1);
     } else {
-        printf("Requette inconnue\n");
+        journaliser(NIVEAU_ERREUR, session_courante, EV_REQUETE_INVALIDE, 0, "Requête inconnue");
+    }
+}
+
+// Fonction pour initialiser la file de requêtes avec une capacité arrondie à la puissance de 2 supérieure
+void initialiser_file(struct file_requetes *file, size_t profondeur) {
+    size_t capacite = 2; // L'algorithme exige au moins deux cases pour distinguer file pleine et file vide
+    while (capacite < profondeur) {
+        capacite <<= 1;
+    }
+    file->cases = malloc(capacite * sizeof(struct case_file));
+    if (file->cases == NULL) {
+        erreur("Erreur lors de l'allocation de la file de requêtes");
+    }
+    for (size_t i = 0; i < capacite; i++) {
+        atomic_init(&file->cases[i].sequence, i);
+    }
+    file->masque = capacite - 1;
+    atomic_init(&file->position_ajout, 0);
+    atomic_init(&file->position_retrait, 0);
+    if (sem_init(&file->requetes_disponibles, 0, 0) < 0) {
+        erreur("Erreur lors de l'initialisation du sémaphore de la file");
     }
+}
+
+// Fonction pour ajouter une requête dans la file sans verrou, retourne -1 si la file est pleine
+int ajouter_requete(struct file_requetes *file, const struct thread_data *data) {
+    size_t position = atomic_load_explicit(&file->position_ajout, memory_order_relaxed);
+    while (1) {
+        struct case_file *c = &file->cases[position & file->masque];
+        size_t sequence = atomic_load_explicit(&c->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            // Case libre : on tente de la réserver
+            if (atomic_compare_exchange_weak_explicit(&file->position_ajout, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                c->donnees = *data;
+                atomic_store_explicit(&c->sequence, position + 1, memory_order_release);
+                sem_post(&file->requetes_disponibles);
+                return 0;
+            }
+        } else if (difference < 0) {
+            // La case n'a pas encore été consommée : la file est pleine
+            return -1;
+        } else {
+            position = atomic_load_explicit(&file->position_ajout, memory_order_relaxed);
+        }
+    }
+}
 
-    free(data); // Libérer la mémoire allouée pour les données de thread
+// Fonction pour retirer une requête de la file, bloquante tant que la file est vide
+void retirer_requete(struct file_requetes *file, struct thread_data *data) {
+    while (sem_wait(&file->requetes_disponibles) < 0 && errno == EINTR) {
+    }
+    size_t position = atomic_load_explicit(&file->position_retrait, memory_order_relaxed);
+    while (1) {
+        struct case_file *c = &file->cases[position & file->masque];
+        size_t sequence = atomic_load_explicit(&c->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&file->position_retrait, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                *data = c->donnees;
+                // La case redevient libre pour le tour suivant de la file circulaire
+                atomic_store_explicit(&c->sequence, position + file->masque + 1, memory_order_release);
+                return;
+            }
+        } else {
+            position = atomic_load_explicit(&file->position_retrait, memory_order_relaxed);
+        }
+    }
+}
+
+// Fonction exécutée par chaque thread de travail du pool
+void* travailleur(void* arg) {
+    struct file_requetes *file = (struct file_requetes *)arg;
+    struct thread_data data;
+    while (1) {
+        retirer_requete(file, &data);
+        traiter_requete(&data);
+        if (data.session != NULL) {
+            retirer_session(data.session);
+        }
+    }
     return NULL;
 }
 
 // Fonction principale
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <port>\n", argv[0]);
+    int nb_travailleurs = NB_TRAVAILLEURS_DEFAUT;
+    int profondeur_file = PROFONDEUR_FILE_DEFAUT;
+    long taille_cache = TAILLE_CACHE_DEFAUT;
+
+    // Lecture des options de la ligne de commande
+    static struct option options_longues[] = {
+        {"quiet", no_argument, NULL, 'Q'},
+        {"metriques", required_argument, NULL, 'U'},
+        {"journal", required_argument, NULL, 'L'},
+        {"limites", required_argument, NULL, 'D'},
+        {"congestion", required_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0}
+    };
+    char *chemin_metriques = NULL;
+    char *chemin_limites = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:q:c:mgs:M:QU:L:D:C:", options_longues, NULL)) != -1) {
+        if (opt == 't') {
+            nb_travailleurs = atoi(optarg);
+        } else if (opt == 'q') {
+            profondeur_file = atoi(optarg);
+        } else if (opt == 'c') {
+            taille_cache = atol(optarg);
+        } else if (opt == 'm') {
+            mode_mmap = 1;
+        } else if (opt == 'g') {
+            mode_gso = 1;
+        } else if (opt == 's') {
+            // Durabilité des WRQ : "aucune", "fin" ou un intervalle de synchronisation en Mo
+            if (strcmp(optarg, "aucune") == 0) {
+                mode_durabilite = DURABILITE_AUCUNE;
+            } else if (strcmp(optarg, "fin") == 0) {
+                mode_durabilite = DURABILITE_FIN;
+            } else if (atol(optarg) > 0) {
+                mode_durabilite = DURABILITE_PERIODIQUE;
+                intervalle_sync = atol(optarg) * 1024LL * 1024;
+            } else {
+                optind = argc + 1;
+                break;
+            }
+        } else if (opt == 'M') {
+            // Groupes multicast (RFC 2090) : adresse et premier port, par exemple 239.255.0.1:1758
+            char *separateur = strchr(optarg, ':');
+            int port = separateur != NULL ? atoi(separateur + 1) : 0;
+            if (separateur != NULL) {
+                *separateur = '\0';
+            }
+            addr_multicast.sin_family = AF_INET;
+            if (port <= 0 || port > 65535 || inet_pton(AF_INET, optarg, &addr_multicast.sin_addr) != 1 ||
+                !IN_MULTICAST(ntohl(addr_multicast.sin_addr.s_addr))) {
+                optind = argc + 1;
+                break;
+            }
+            addr_multicast.sin_port = htons(port);
+            prochain_port_multicast = port;
+        } else if (opt == 'Q') {
+            niveau_journal = NIVEAU_ERREUR;
+        } else if (opt == 'L') {
+            // Niveau du journal : erreur, info (par défaut) ou debug pour les événements par bloc
+            niveau_journal = -1;
+            for (int i = NIVEAU_ERREUR; i <= NIVEAU_DEBUG; i++) {
+                if (strcmp(optarg, noms_niveaux[i]) == 0) {
+                    niveau_journal = i;
+                }
+            }
+            if (niveau_journal < 0) {
+                optind = argc + 1;
+                break;
+            }
+        } else if (opt == 'U') {
+            chemin_metriques = optarg;
+        } else if (opt == 'C') {
+            // Contrôle de congestion des RRQ : aucun (par défaut), aimd ou delai. Il rythme l'envoi des fenêtres
+            // négociées de plus de CWND_MIN blocs, les plus petites partent comme sans contrôle
+            mode_congestion = -1;
+            for (int i = CONGESTION_AUCUN; i <= CONGESTION_DELAI; i++) {
+                if (strcmp(optarg, noms_congestion[i]) == 0) {
+                    mode_congestion = i;
+                }
+            }
+            if (mode_congestion < 0) {
+                optind = argc + 1;
+                break;
+            }
+        } else if (opt == 'D') {
+            // Fichier des limites de débit, relu à chaque SIGHUP : "global=10G sous_reseau=1G/24 session=100M"
+            chemin_limites = optarg;
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (argc - optind != 1 || nb_travailleurs < 1 || profondeur_file < 1 || taille_cache < 0) {
+        fprintf(stderr, "Usage: %s [-t nb_threads] [-q profondeur_file] [-c taille_cache_Mo] [-m] [-g] [-s aucune|fin|intervalle_sync_Mo] [-M adresse_multicast:port] [-Q|--quiet] [-L erreur|info|debug] [-U socket_metriques] [-D fichier_limites] [-C aucun|aimd|delai] <port>\n", argv[0]);
         exit(1);
     }
 
@@ -271,39 +1686,85 @@ int main(int argc, char *argv[]) {
     struct sockaddr_in addr_serveur;
 
     // Initialisation du socket
-    initialiser_socket(&sockfd, &addr_serveur, atoi(argv[1]));
+    initialiser_socket(&sockfd, &addr_serveur, atoi(argv[optind]));
+
+    // Les noyaux antérieurs à Linux 4.18 ne connaissent pas UDP_SEGMENT
+    int taille_segment = BLKSIZE_DEFAUT + 4;
+    if (mode_gso && setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &taille_segment, sizeof(taille_segment)) < 0) {
+        perror("UDP_SEGMENT non supporté, envoi classique");
+        mode_gso = 0;
+    }
+    taille_segment = 0; // Le socket d'écoute n'envoie que des datagrammes isolés
+    setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &taille_segment, sizeof(taille_segment));
+    initialiser_table_verrous();
+    initialiser_table_sessions();
+    cache.capacite = taille_cache * 1024 * 1024;
+    metriques_cache = 1;
+    // Premier thread créé : les suivants héritent du masque qui lui réserve SIGHUP
+    if (chemin_limites != NULL) {
+        demarrer_limiteur(chemin_limites);
+        metriques_regulation = 1;
+    }
+    if (chemin_metriques != NULL) {
+        demarrer_metriques(chemin_metriques);
+    }
+    demarrer_journal();
 
-    printf("Serveur TFTP démarré sur le port %s...\n", argv[1]);
+    // Création du pool de threads de travail alimenté par la file de requêtes
+    static struct file_requetes file;
+    initialiser_file(&file, profondeur_file);
+    pthread_attr_t attributs;
+    pthread_attr_init(&attributs);
+    pthread_attr_setstacksize(&attributs, TAILLE_PILE_TRAVAILLEUR);
+    pthread_attr_setdetachstate(&attributs, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < nb_travailleurs; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, &attributs, travailleur, &file) != 0) {
+            erreur("Erreur lors de la création du thread de travail");
+        }
+    }
+    pthread_attr_destroy(&attributs);
 
-    while (1) {
-        struct sockaddr_in addr_client;
-        struct tftp_request buffer;
-        socklen_t longueur_client = sizeof(struct sockaddr_in);
+    printf("Serveur TFTP démarré sur le port %s avec %d threads...\n", argv[optind], nb_travailleurs);
 
-        // Recevoir la requête du client avec timeout
-        int bytes_recus = recvfrom(sockfd, &buffer, sizeof(struct tftp_request), 0, (struct sockaddr *)&addr_client, &longueur_client);
-        if (bytes_recus < 0) {
+    // Les requêtes arrivées en rafale sont lues d'un seul appel recvmmsg
+    static struct lot_reception requetes;
+    initialiser_lot_reception(&requetes);
+
+    while (1) {
+        // Recevoir les requêtes des clients
+        int nb_recus = recevoir_lot(sockfd, &requetes);
+        if (nb_recus < 0) {
             perror("Erreur de réception des données");
             continue;
         }
 
-        // Allouer de la mémoire pour les données du thread
-        struct thread_data *data = malloc(sizeof(struct thread_data));
-        if (data == NULL) {
-            perror("Erreur lors de l'allocation de mémoire pour les données de thread");
-            continue;
-        }
-        data->requete = buffer;
-        data->addr_client = addr_client;
-        
-        // Créer un thread pour traiter la requête
-        pthread_t tid;
-        if (pthread_create(&tid, NULL, process_request, (void *)data) != 0) {
-            perror("Erreur lors de la création du thread de traitement");
-            free(data);
-            continue;
+        for (int i = 0; i < nb_recus; i++) {
+            struct thread_data data;
+            memcpy(data.requete, requetes.tampons[i], requetes.messages[i].msg_len);
+            data.taille_requete = requetes.messages[i].msg_len;
+            data.addr_client = requetes.sources[i];
+            data.session = NULL;
+
+            // Seule une requête bien formée est inscrite, le thread de travail signale les autres
+            struct paquet_decode requete;
+            if (decoder_paquet(data.requete, data.taille_requete, &requete) == 0 && (requete.opcode == OPCODE_RRQ || requete.opcode == OPCODE_WRQ)) {
+                data.session = inscrire_session(&data.addr_client, requete.opcode, requete.nom_fichier.texte);
+                if (data.session == NULL) {
+                    // Requête retransmise par le client : la session déjà lancée lui répond
+                    journaliser(NIVEAU_INFO, 0, EV_DOUBLON, 0, "Requête dupliquée ignorée pour le fichier '%s'", requete.nom_fichier.texte);
+                    continue;
+                }
+            }
+
+            // Confier la requête au pool, ou la refuser si tous les threads sont occupés et la file pleine
+            if (ajouter_requete(&file, &data) < 0) {
+                envoyer_erreur(sockfd, &data.addr_client, 0, "Serveur surchargé, réessayez plus tard.");
+                if (data.session != NULL) {
+                    retirer_session(data.session);
+                }
+            }
         }
-        pthread_detach(tid); // Détacher le thread pour libérer les ressources automatiquement
     }
 
     close(sockfd);